@@ -0,0 +1,63 @@
+/**
+ *  Times MUsortEdges()'s two sorts, std::sort(MULT) and MUbucketSortEdges(), on random edges
+ *  whose tops span a given number of rows. The table it prints is what kBucketSortMinEdges and
+ *  kBucketSortMaxRowsPerEdge are chosen from.
+ *
+ *  g++ -std=c++14 -O2 -I<dir holding include/> -Iv6 v6/bench/sort_edges.cpp
+ */
+
+#include "my_utils.h"
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+
+static double time_sort(const std::vector<my_edge>& src, bool bucket, my_edge_sort_scratch& scratch) {
+    int min_top = src[0].top, max_top = src[0].top;
+    for (const my_edge& e : src) {
+        min_top = std::min(min_top, e.top);
+        max_top = std::max(max_top, e.top);
+    }
+
+    std::vector<my_edge> edges;
+    int reps = std::max(20, (int) (4000000 / src.size()));
+    double best = 1e30;
+    for (int run = 0; run < 3; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < reps; ++i) {
+            edges.assign(src.begin(), src.end());
+            if (bucket) {
+                MUbucketSortEdges(edges, min_top, max_top, scratch);
+            } else {
+                std::sort(edges.begin(), edges.end(), MULT);
+            }
+        }
+        std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+        best = std::min(best, t.count() / reps);
+    }
+    return best;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    my_edge_sort_scratch scratch;
+
+    printf("%6s %6s %12s %12s\n", "rows", "edges", "sort (ns)", "bucket (ns)");
+    for (int rows : { 256, 1024, 4096, 16384 }) {
+        for (int count : { 16, 32, 48, 64, 128, 256, 512, 1024, 4096, 16384 }) {
+            std::vector<my_edge> src(count);
+            for (my_edge& e : src) {
+                e.top = rng() % rows;
+                e.bottom = e.top + 1 + rng() % 64;
+                e.fx = (int64_t) rng() << 16;
+                e.fdx = 0;
+                e.m = 0;
+                e.winding = 1;
+            }
+            double sorted = time_sort(src, false, scratch);
+            double bucketed = time_sort(src, true, scratch);
+            printf("%6d %6d %12.0f %12.0f%s\n", rows, count, sorted, bucketed, bucketed < sorted ? "  *" : "");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,407 @@
+#ifndef my_aa_DEFINED
+#define my_aa_DEFINED
+
+#include "include/GPoint.h"
+#include "include/GMath.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <math.h>
+
+#include "my_simd.h"
+
+/**
+ *  How drawPath / drawConvexPolygon turn geometry into pixels.
+ *      kNone           whole pixels whose centers are inside (the containment rule)
+ *      kAnalytic       exact signed-area coverage per pixel (my_coverage_rasterizer)
+ *      kSupersample4   4 x 4 samples per pixel through the regular edge walker
+ *      kSupersample16  16 x 16 samples per pixel, slower but finer coverage steps
+ */
+enum class my_aa_mode {
+    kNone,
+    kAnalytic,
+    kSupersample4,
+    kSupersample16,
+};
+
+// log2 of the samples per pixel side for the supersampled modes, 0 for the others
+static inline int MUsupersampleShift(my_aa_mode mode) {
+    switch (mode) {
+        case my_aa_mode::kSupersample4: return 2;
+        case my_aa_mode::kSupersample16: return 4;
+        default: return 0;
+    }
+}
+
+/**
+ *  Rows of coverage gathered into an A8 mask, so an anti-aliased fill reaches the blitter up to
+ *  kRows rows at a time (my_blitter::blitMask). The rasterizers write each row's coverage
+ *  straight into the mask (row(), commit()), top to bottom; a row that doesn't follow the last
+ *  one, or a full mask, hands over what has been gathered first. The mask handed over spans
+ *  the union of the rows' coverage inside the clip, with 0 wherever a row has none; only those
+ *  gaps are cleared, since every row's own span was just written.
+ */
+class my_coverage_mask {
+public:
+    static const int kRows = 16;
+
+    // start gathering for a device width pixels wide, keeping the columns [left, right)
+    void reset(int width, int left, int right) {
+        w = width;
+        clip_left = left;
+        clip_right = right;
+        if ((int) mask.size() < kRows * w) {
+            mask.resize(kRows * w);
+        }
+        rows = 0;
+        lo = clip_right;
+        hi = clip_left;
+    }
+
+    /**
+     *  The row (indexed by device x) to write row y's coverage into, handing what has been
+     *  gathered to blit first if y can't join it. Follow with commit().
+     */
+    template <typename Blit>
+    uint8_t* row(int y, Blit blit) {
+        if (rows > 0 && (rows == kRows || y != top + rows)) {
+            flush(blit);
+        }
+        if (rows == 0) top = y;
+        return mask.data() + rows * w;
+    }
+
+    // the row from row() now holds coverage for [x0, x1), 0 <= x0 <= x1 <= width; the rest
+    // of it counts as 0
+    void commit(int x0, int x1) {
+        x0 = std::max(x0, clip_left);
+        x1 = std::min(x1, clip_right);
+        spans[rows][0] = x0;
+        spans[rows][1] = std::max(x0, x1);
+        if (x0 < x1) {
+            lo = std::min(lo, x0);
+            hi = std::max(hi, x1);
+        }
+        rows++;
+    }
+
+    // hand what has been gathered to blit(mask, rowBytes, x, y, width, height), as for blitMask
+    template <typename Blit>
+    void flush(Blit blit) {
+        if (rows > 0 && lo < hi) {
+            for (int i = 0; i < rows; ++i) {
+                uint8_t* row = mask.data() + i * w;
+                int x0 = std::min(std::max(spans[i][0], lo), hi);
+                int x1 = std::min(std::max(spans[i][1], x0), hi);
+                std::fill(row + lo, row + x0, 0);
+                std::fill(row + x1, row + hi, 0);
+            }
+            blit(mask.data() + lo, (size_t) w, lo, top, hi - lo, rows);
+        }
+        rows = 0;
+        lo = clip_right;
+        hi = clip_left;
+    }
+
+private:
+    int w = 0;
+    int clip_left = 0, clip_right = 0;
+    int top = 0, rows = 0;
+    int lo = 0, hi = 0;         // columns [lo, hi) have coverage in some row
+    int spans[kRows][2];        // each row's [x0, x1) inside the clip, the only part that counts
+    std::vector<uint8_t> mask;  // kRows rows of w
+};
+
+/**
+ *  Coverage for one pixel row, built from the spans of its sub-scanlines. Spans are in
+ *  supersampled x (pixel x << shift); each sample a span covers adds 1 to its pixel, so a
+ *  fully covered pixel ends up at 1 << (2 * shift).
+ */
+class my_supersample_mask {
+public:
+    void reset(int width, int sample_shift) {
+        w = width;
+        shift = sample_shift;
+        if ((int) acc.size() < w + 1) {
+            acc.assign(w + 1, 0);
+        }
+        lo = w;
+        hi = 0;
+    }
+
+    // add the samples [x0, x1) of one sub-scanline, 0 <= x0 <= x1 <= width << shift
+    void addSpan(int x0, int x1) {
+        if (x0 >= x1) return;
+
+        int mask = (1 << shift) - 1;
+        int p0 = x0 >> shift;
+        int p1 = x1 >> shift;
+        lo = std::min(lo, p0);
+        hi = std::max(hi, p1 + 1);
+
+        if (p0 == p1) {
+            acc[p0] += x1 - x0;
+            return;
+        }
+        acc[p0] += (1 << shift) - (x0 & mask);
+        for (int x = p0 + 1; x < p1; ++x) {
+            acc[x] += 1 << shift;
+        }
+        acc[p1] += x1 & mask;
+    }
+
+    /**
+     *  Write the row's coverage, as 0...255, into out as row y (see my_coverage_mask, which
+     *  may hand earlier rows to blit), and clear the samples for the next row.
+     */
+    template <typename Blit>
+    void flush(int y, my_coverage_mask& out, Blit blit) {
+        hi = std::min(hi, w);
+        if (lo < hi) {
+            uint8_t* coverage = out.row(y, blit);
+            int bits = 2 * shift;
+            for (int x = lo; x < hi; ++x) {
+                coverage[x] = (uint8_t) ((acc[x] * 255 + (1 << (bits - 1))) >> bits);
+            }
+            out.commit(lo, hi);
+            std::fill(acc.begin() + lo, acc.begin() + hi + 1, 0);
+        }
+        lo = w;
+        hi = 0;
+    }
+
+private:
+    int w = 0, shift = 0;
+    int lo = 0, hi = 0;             // pixels [lo, hi) have samples
+    std::vector<uint16_t> acc;      // w + 1 sample counts, the extra one for spans ending at w
+};
+
+struct my_aa_line {
+    float x0, y0, x1, y1;   // y0 < y1
+    float dir;              // +1 if the original line went down, else -1
+    float dxdy;
+};
+
+/**
+ *  The lines of one shape for analytic anti-aliasing, in device space, sorted by y0 once
+ *  finish() is called. Kept apart from my_coverage_rasterizer so a shape can be built once
+ *  and rasterized into any number of clips.
+ *
+ *  Lines are clipped to the device's rows and split where they cross x = 0 and x = width:
+ *  the parts outside become vertical lines on the border, which leaves the coverage of every
+ *  visible pixel unchanged.
+ */
+class my_aa_lines {
+public:
+    // start a new shape on a device of the given size
+    void reset(int width, int height) {
+        w = width;
+        h = height;
+        lines.clear();
+    }
+
+    void addLine(GPoint p0, GPoint p1) {
+        if (p0.fY == p1.fY) return;
+
+        // in double, so the crossings of lines reaching far outside the device (1e10 for "fill
+        // to the edge") stay accurate
+        double x0 = p0.fX, y0 = p0.fY, x1 = p1.fX, y1 = p1.fY;
+        float dir = 1;
+        if (y0 > y1) {
+            std::swap(x0, x1);
+            std::swap(y0, y1);
+            dir = -1;
+        }
+
+        // only rows [0, h) are rasterized, so clip to them
+        if (y1 <= 0 || y0 >= h) return;
+        double dxdy = (x1 - x0) / (y1 - y0);
+        if (y0 < 0) {
+            x0 -= y0 * dxdy;
+            y0 = 0;
+        }
+        if (y1 > h) {
+            x1 -= (y1 - h) * dxdy;
+            y1 = h;
+        }
+
+        // split at the left and right borders
+        double t[4] = { 0, 1, 1, 1 };
+        int n = 1;
+        for (double x : { 0.0, (double) w }) {
+            if ((x0 < x) != (x1 < x)) {
+                t[n++] = (x - x0) / (x1 - x0);
+            }
+        }
+        if (n == 3 && t[2] < t[1]) std::swap(t[1], t[2]);
+        t[n] = 1;
+
+        double ax = x0, ay = y0;
+        for (int i = 1; i <= n; ++i) {
+            double bx = i == n ? x1 : x0 + t[i] * (x1 - x0);
+            double by = i == n ? y1 : y0 + t[i] * (y1 - y0);
+            addClamped(ax, ay, bx, by, dir);
+            ax = bx;
+            ay = by;
+        }
+    }
+
+    // done adding lines
+    void finish() {
+        std::sort(lines.begin(), lines.end(), [](const my_aa_line& a, const my_aa_line& b) {
+            return a.y0 < b.y0;
+        });
+        max_y = 0;
+        for (const my_aa_line& l : lines) {
+            max_y = std::max(max_y, l.y1);
+        }
+    }
+
+    int w = 0, h = 0;
+    float max_y = 0;
+    std::vector<my_aa_line> lines;
+
+private:
+    // add a line (y0 <= y1) that doesn't cross a border, moving it onto the border if it's
+    // outside
+    void addClamped(double x0, double y0, double x1, double y1, float dir) {
+        my_aa_line l;
+        l.x0 = (float) std::min(std::max(x0, 0.0), (double) w);
+        l.y0 = (float) y0;
+        l.x1 = (float) std::min(std::max(x1, 0.0), (double) w);
+        l.y1 = (float) y1;
+        if (l.y0 == l.y1) return;
+        l.dir = dir;
+        l.dxdy = (l.x1 - l.x0) / (l.y1 - l.y0);
+        lines.push_back(l);
+    }
+};
+
+/**
+ *  Analytic anti-aliasing. Every line adds the signed area it sweeps to the right of itself
+ *  into a per-row accumulation buffer; a prefix sum over the row then gives each pixel's
+ *  winding-weighted coverage, and |coverage| clamped to 1 approximates non-zero winding.
+ */
+class my_coverage_rasterizer {
+public:
+    /**
+     *  Compute coverage for every row in [top, bottom) the shape touches and write it, as
+     *  0...255, into out (see my_coverage_mask, which hands it to blit), reset for the shape's
+     *  device. Rows may stop at right, and may go a little past it with coverage that's
+     *  meaningless there, so out should clip at right. Pixels come out the same whatever
+     *  range they're asked for in.
+     */
+    template <typename Blit>
+    void rasterize(const my_aa_lines& shape, int top, int bottom, int right, my_coverage_mask& out, Blit blit) {
+        const std::vector<my_aa_line>& lines = shape.lines;
+        if (lines.empty()) return;
+
+        int w = shape.w;
+        if ((int) acc.size() < w + 2) {
+            acc.assign(w + 2, 0);
+        }
+
+        int y = std::max(GFloorToInt(lines.front().y0), std::max(top, 0));
+        int stop = std::min(GCeilToInt(shape.max_y), std::min(bottom, shape.h));
+
+        active.clear();
+        size_t next = 0;
+        for (; y < stop; ++y) {
+            // drop finished lines, pick up the ones that start in this row
+            int live = 0;
+            for (int i : active) {
+                if (lines[i].y1 > y) active[live++] = i;
+            }
+            active.resize(live);
+            while (next < lines.size() && lines[next].y0 < y + 1) {
+                active.push_back((int) next++);
+            }
+            if (active.empty()) continue;
+
+            // acc[lo...hi] is the part of the row the lines touched; the rest stays 0
+            int lo = w + 1, hi = -1;
+            for (int i : active) {
+                accumulate(lines[i], y, right, &lo, &hi);
+            }
+            if (hi < lo) continue;
+
+            // past hi the running sum no longer changes, and is 0 for a closed shape. Stopping
+            // at right, rounded up to a whole MUaccumulateCoverage block so the sums before it
+            // are added the same way, saves what's right of a tile.
+            int count = std::min(std::min(hi + 1, w) - lo, (right - lo + 3) & ~3);
+            if (count > 0) {
+                MUaccumulateCoverage(acc.data() + lo, out.row(y, blit) + lo, count);
+                out.commit(lo, lo + count);
+            }
+            std::fill(acc.begin() + lo, acc.begin() + hi + 1, 0.f);
+        }
+        out.flush(blit);
+    }
+
+private:
+    // add the area the part of l inside row y sweeps, to the right of it, unless that's all
+    // at or past right
+    void accumulate(const my_aa_line& l, int y, int right, int* lo, int* hi) {
+        float ya = std::max((float) y, l.y0);
+        float yb = std::min((float) (y + 1), l.y1);
+        if (ya >= yb) return;
+
+        // rounding can put these a hair past the line's ends, which for a line on x = 0 is
+        // outside acc
+        float xmin = std::min(l.x0, l.x1);
+        float xmax = std::max(l.x0, l.x1);
+        float xa = std::min(std::max(l.x0 + (ya - l.y0) * l.dxdy, xmin), xmax);
+        float xb = std::min(std::max(l.x0 + (yb - l.y0) * l.dxdy, xmin), xmax);
+        float d = (yb - ya) * l.dir;
+
+        float x0 = std::min(xa, xb);
+        float x1 = std::max(xa, xb);
+        float x0floor = floorf(x0);
+        int x0i = (int) x0floor;
+        float x1ceil = ceilf(x1);
+        int x1i = (int) x1ceil;
+        if (x0i >= right) {
+            // the pixels up to right still get the winding it closes
+            *hi = std::max(*hi, right);
+            return;
+        }
+        float* a = acc.data();
+
+        *lo = std::min(*lo, x0i);
+        *hi = std::max(*hi, std::max(x1i, x0i + 1));
+
+        if (x1i <= x0i + 1) {
+            // stays in one pixel: split d by where the midpoint falls
+            float xmf = 0.5f * (xa + xb) - x0floor;
+            a[x0i] += d - d * xmf;
+            a[x0i + 1] += d * xmf;
+            return;
+        }
+
+        float s = 1 / (x1 - x0);
+        float x0f = x0 - x0floor;
+        float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+        float x1f = x1 - x1ceil + 1;
+        float am = 0.5f * s * x1f * x1f;
+
+        a[x0i] += d * a0;
+        if (x1i == x0i + 2) {
+            a[x0i + 1] += d * (1 - a0 - am);
+        } else {
+            float a1 = s * (1.5f - x0f);
+            a[x0i + 1] += d * (a1 - a0);
+            for (int xi = x0i + 2; xi < x1i - 1; ++xi) {
+                a[xi] += d * s;
+            }
+            float a2 = a1 + (x1i - x0i - 3) * s;
+            a[x1i - 1] += d * (1 - a2 - am);
+        }
+        a[x1i] += d * am;
+    }
+
+    std::vector<int> active;
+    std::vector<float> acc;         // w + 2 signed areas for the current row
+};
+
+#endif
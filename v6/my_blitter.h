@@ -0,0 +1,254 @@
+#ifndef my_blitter_DEFINED
+#define my_blitter_DEFINED
+
+#include "include/GBitmap.h"
+#include "include/GPixel.h"
+#include "include/GShader.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "my_utils.h"
+#include "my_simd.h"
+#include "my_scratch.h"
+#include "my_shader.h"
+
+/**
+ *  Everything a draw needs for each span, worked out once when the draw starts
+ *  (my_canvas::makeContext) and handed to the blitter that draws it.
+ */
+struct my_draw_context {
+    GBlendMode mode;            // blend mode after reduction (MUreduceBlendMode)
+    my_blend_procs procs;       // row procs for mode
+    GPixel src;                 // premultiplied paint color, used when shader is null
+    GShader* shader;            // null for a solid color
+    my_base_shader* fused;      // shader, if it can blend straight into the device row
+    bool opaque;                // every src pixel has alpha 255
+};
+
+/**
+ *  The only way the rasterizers touch device pixels. They hand over runs (blitH), runs with
+ *  per-pixel coverage (blitAntiH), whole rectangles (blitRect) or A8 masks (blitMask), and
+ *  each subclass fills them the cheapest way for its kind of paint: solid color or shader,
+ *  and a source that replaces the device (the copy blitters) or one blended with it.
+ *
+ *  A blitter has no per-draw state besides its context, so one can be shared by the threads
+ *  of a draw; scratch rows come from my_scratch::get().
+ */
+class my_blitter {
+public:
+    explicit my_blitter(const GBitmap& device) : fDevice(device) {}
+    virtual ~my_blitter() {}
+
+    // set up for the next draw
+    void setContext(const my_draw_context& ctx) {
+        fCtx = ctx;
+    }
+
+    /**
+     *  Blend the pixels [x, x + count) of row y.
+     */
+    virtual void blitH(int x, int y, int count) {
+        blend(MUrowAddr(fDevice, y) + x, x, y, count);
+    }
+
+    /**
+     *  Blend the pixels [x, x + count) of row y, weighted by coverage[0...count - 1] (0...255).
+     *  Uncovered runs are skipped, fully covered runs go to blitH and the rest to blendPartial,
+     *  which blends a copy of the device and lerps it back. The copy blitters, whose source
+     *  doesn't depend on the device, store and lerp their source directly instead.
+     */
+    virtual void blitAntiH(int x, int y, int count, const uint8_t coverage[]) {
+        GPixel* row = MUrowAddr(fDevice, y);
+        for (int i = 0; i < count;) {
+            uint8_t c = coverage[i];
+            int n = runLength(coverage + i, count - i);
+            if (c == 255) {
+                blitH(x + i, y, n);
+            } else if (c != 0) {
+                blendPartial(row + x + i, x + i, y, n, coverage + i);
+            }
+            i += n;
+        }
+    }
+
+    /**
+     *  Blend the rectangle [x, x + width) x [y, y + height).
+     */
+    virtual void blitRect(int x, int y, int width, int height) {
+        for (int i = 0; i < height; ++i) {
+            blitH(x, y + i, width);
+        }
+    }
+
+    /**
+     *  Blend the rectangle [x, x + width) x [y, y + height) weighted by an A8 mask, where
+     *  mask[0] is the coverage of (x, y) and its rows are rowBytes apart. The anti-aliased
+     *  fills hand their coverage over this way, a few rows at a time (my_coverage_mask).
+     */
+    virtual void blitMask(const uint8_t mask[], size_t rowBytes, int x, int y, int width, int height) {
+        for (int i = 0; i < height; ++i) {
+            blitAntiH(x, y + i, width, mask + i * rowBytes);
+        }
+    }
+
+protected:
+    /**
+     *  Blend count pixels of row y starting at device x into dst, which points at the pixel
+     *  for x (in the device, or in a row standing in for it).
+     */
+    virtual void blend(GPixel* dst, int x, int y, int count) = 0;
+
+    // blend a partially covered run into a copy of dst, then lerp the copy back by coverage
+    virtual void blendPartial(GPixel* dst, int x, int y, int count, const uint8_t coverage[]) {
+        my_scratch& scratch = my_scratch::get();
+        GPixel* tmp = scratch.acquire(count);
+        MUcopyRow(tmp, dst, count);
+        blend(tmp, x, y, count);
+        MUlerpRow(dst, tmp, coverage, count);
+        scratch.release();
+    }
+
+    /**
+     *  Length of the run coverage[0...count - 1] starts with: all 0, all 255, or partial
+     *  values (none 0 or 255). The first two, long in a mask or the inside of a big shape,
+     *  are checked 8 bytes at a time.
+     */
+    static int runLength(const uint8_t coverage[], int count) {
+        uint8_t c = coverage[0];
+        int n = 1;
+        if (c == 0 || c == 255) {
+            uint64_t all = c == 0 ? 0 : ~(uint64_t) 0;
+            for (uint64_t v; n + 8 <= count; n += 8) {
+                memcpy(&v, coverage + n, 8);
+                if (v != all) break;
+            }
+            while (n < count && coverage[n] == c) ++n;
+        } else {
+            while (n < count && coverage[n] != 0 && coverage[n] != 255) ++n;
+        }
+        return n;
+    }
+
+    // call run(i, n, full) for each covered run of coverage[0...count - 1] (see runLength)
+    template <typename Run>
+    static void coverageRuns(const uint8_t coverage[], int count, Run run) {
+        for (int i = 0; i < count;) {
+            uint8_t c = coverage[i];
+            int n = runLength(coverage + i, count - i);
+            if (c != 0) {
+                run(i, n, c == 255);
+            }
+            i += n;
+        }
+    }
+
+    const GBitmap fDevice;
+    my_draw_context fCtx;
+};
+
+// solid color that has to be blended with the device
+class my_solid_blitter final : public my_blitter {
+public:
+    explicit my_solid_blitter(const GBitmap& device) : my_blitter(device) {}
+
+protected:
+    void blend(GPixel* dst, int, int, int count) override {
+        fCtx.procs.color(dst, fCtx.src, count);
+    }
+};
+
+// solid color that replaces the device (kSrc, clears, opaque kSrcOver): plain stores
+class my_solid_copy_blitter final : public my_blitter {
+public:
+    explicit my_solid_copy_blitter(const GBitmap& device) : my_blitter(device) {}
+
+    // full-width rects over contiguous rows are a single bulk fill
+    void blitRect(int x, int y, int width, int height) override {
+        if (x == 0 && width == fDevice.width() && fDevice.rowBytes() == width * sizeof(GPixel)) {
+            MUfillPixels(MUrowAddr(fDevice, y), fCtx.src, (size_t) width * height);
+            return;
+        }
+        for (int i = 0; i < height; ++i) {
+            MUfillPixels(MUrowAddr(fDevice, y + i) + x, fCtx.src, width);
+        }
+    }
+
+    void blitAntiH(int x, int y, int count, const uint8_t coverage[]) override {
+        fill(MUrowAddr(fDevice, y) + x, count, coverage);
+    }
+
+    void blitMask(const uint8_t mask[], size_t rowBytes, int x, int y, int width, int height) override {
+        for (int i = 0; i < height; ++i) {
+            fill(MUrowAddr(fDevice, y + i) + x, width, mask + i * rowBytes);
+        }
+    }
+
+protected:
+    void blend(GPixel* dst, int, int, int count) override {
+        MUfillPixels(dst, fCtx.src, count);
+    }
+
+private:
+    // store the color over full runs and lerp it in elsewhere, in one pass over the coverage
+    void fill(GPixel* dst, int count, const uint8_t coverage[]) {
+        coverageRuns(coverage, count, [&](int i, int n, bool full) {
+            if (full) {
+                MUfillPixels(dst + i, fCtx.src, n);
+            } else {
+                for (int k = i; k < i + n; ++k) {
+                    dst[k] = MUlerpPixel(dst[k], fCtx.src, coverage[k]);
+                }
+            }
+        });
+    }
+};
+
+// shader that has to be blended with the device
+class my_shader_blitter final : public my_blitter {
+public:
+    explicit my_shader_blitter(const GBitmap& device) : my_blitter(device) {}
+
+protected:
+    void blend(GPixel* dst, int x, int y, int count) override {
+        if (fCtx.fused != nullptr) {
+            fCtx.fused->shadeAndBlendRow(x, y, count, dst, fCtx.mode, fCtx.procs.row);
+            return;
+        }
+        my_scratch& scratch = my_scratch::get();
+        GPixel* row = scratch.acquire(count);
+        fCtx.shader->shadeRow(x, y, count, row);
+        fCtx.procs.row(dst, row, count);
+        scratch.release();
+    }
+};
+
+// shader whose output replaces the device: it shades straight into the row
+class my_shader_copy_blitter final : public my_blitter {
+public:
+    explicit my_shader_copy_blitter(const GBitmap& device) : my_blitter(device) {}
+
+    // full runs shade straight into the device; the shader doesn't read it, so partly covered
+    // ones shade into scratch without copying the device first
+    void blitAntiH(int x, int y, int count, const uint8_t coverage[]) override {
+        GPixel* row = MUrowAddr(fDevice, y) + x;
+        coverageRuns(coverage, count, [&](int i, int n, bool full) {
+            if (full) {
+                fCtx.shader->shadeRow(x + i, y, n, row + i);
+                return;
+            }
+            my_scratch& scratch = my_scratch::get();
+            GPixel* tmp = scratch.acquire(n);
+            fCtx.shader->shadeRow(x + i, y, n, tmp);
+            MUlerpRow(row + i, tmp, coverage + i, n);
+            scratch.release();
+        });
+    }
+
+protected:
+    void blend(GPixel* dst, int x, int y, int count) override {
+        fCtx.shader->shadeRow(x, y, count, dst);
+    }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef my_bvh_DEFINED
+#define my_bvh_DEFINED
+
+#include "include/GRect.h"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ *  A bounding volume hierarchy over a set of rects, for finding the ones that intersect a
+ *  query rect without testing them all. Built top down: a node's rects are split at the
+ *  median of their centers along the longer side of the node's bounds, down to kLeafSize
+ *  rects per leaf, so queries take O(log n + found).
+ */
+class my_bvh {
+public:
+    static const int kLeafSize = 4;
+
+    void build(const std::vector<GRect>& rects) {
+        nodes.clear();
+        order.resize(rects.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = (int) i;
+        }
+        leaf_bounds.resize(rects.size());
+        if (!rects.empty()) {
+            nodes.resize(1);
+            build(rects, 0, 0, (int) rects.size());
+        }
+    }
+
+    /**
+     *  Call visit(i) for every rect i that intersects r (touching counts), in no particular
+     *  order.
+     */
+    template <typename Visit>
+    void search(const GRect& r, Visit visit) const {
+        if (nodes.empty()) return;
+
+        int stack[64];
+        int depth = 0;
+        stack[depth++] = 0;
+        while (depth > 0) {
+            const node& n = nodes[stack[--depth]];
+            if (!intersects(n.bounds, r)) continue;
+
+            if (n.count > 0) {
+                for (int i = n.first; i < n.first + n.count; ++i) {
+                    if (intersects(leaf_bounds[i], r)) visit(order[i]);
+                }
+            } else {
+                stack[depth++] = n.left;
+                stack[depth++] = n.left + 1;
+            }
+        }
+    }
+
+private:
+    struct node {
+        GRect bounds;
+        int left;       // children are nodes[left] and nodes[left + 1], unless a leaf
+        int first;      // a leaf's rects are order[first ... first + count - 1]
+        int count;      // 0 for an inner node
+    };
+
+    static bool intersects(const GRect& a, const GRect& b) {
+        return a.fLeft <= b.fRight && b.fLeft <= a.fRight && a.fTop <= b.fBottom && b.fTop <= a.fBottom;
+    }
+
+    // fill in nodes[index], the node for order[first ... end - 1]
+    void build(const std::vector<GRect>& rects, int index, int first, int end) {
+        GRect bounds = rects[order[first]];
+        for (int i = first + 1; i < end; ++i) {
+            const GRect& r = rects[order[i]];
+            bounds.fLeft = std::min(bounds.fLeft, r.fLeft);
+            bounds.fTop = std::min(bounds.fTop, r.fTop);
+            bounds.fRight = std::max(bounds.fRight, r.fRight);
+            bounds.fBottom = std::max(bounds.fBottom, r.fBottom);
+        }
+        nodes[index].bounds = bounds;
+
+        if (end - first <= kLeafSize) {
+            nodes[index].first = first;
+            nodes[index].count = end - first;
+            for (int i = first; i < end; ++i) {
+                leaf_bounds[i] = rects[order[i]];
+            }
+            return;
+        }
+
+        bool by_x = bounds.fRight - bounds.fLeft > bounds.fBottom - bounds.fTop;
+        int mid = first + (end - first) / 2;
+        std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+            const GRect& ra = rects[a];
+            const GRect& rb = rects[b];
+            return by_x ? ra.fLeft + ra.fRight < rb.fLeft + rb.fRight
+                        : ra.fTop + ra.fBottom < rb.fTop + rb.fBottom;
+        });
+
+        // children go next to each other, so an inner node only needs the first
+        int left = (int) nodes.size();
+        nodes.resize(left + 2);
+        nodes[index].left = left;
+        nodes[index].count = 0;
+        build(rects, left, first, mid);
+        build(rects, left + 1, mid, end);
+    }
+
+    std::vector<node> nodes;
+    std::vector<int> order;
+    std::vector<GRect> leaf_bounds;     // rects[order[i]], so leaves test without indirection
+};
+
+#endif
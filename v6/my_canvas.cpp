@@ -12,18 +12,34 @@
 #include <iostream>
 #include <vector>
 #include <stack>
+#include <functional>
+#include <atomic>
+#include <mutex>
 
 #include "my_utils.h"
 #include "my_edge.h"
 #include "my_shader.h"
+#include "my_simd.h"
+#include "my_thread_pool.h"
+#include "my_scratch.h"
+#include "my_aa.h"
+#include "my_blitter.h"
+#include "my_tiles.h"
+#include "my_display_list.h"
 
 class my_canvas : public GCanvas {
 public:
-    my_canvas(const GBitmap& device) : fDevice(device), width(device.width()), height(device.height()) {
+    my_canvas(const GBitmap& device) : fDevice(device), width(device.width()), height(device.height()), fScratch(device.width()),
+                                       fSolidBlitter(device), fSolidCopyBlitter(device), fShaderBlitter(device), fShaderCopyBlitter(device) {
         ctm = GMatrix();
+        fClip = deviceRect();
         save();
     }
 
+    ~my_canvas() override {
+        flush();
+    }
+
     /**
      *  Save off a copy of the canvas state (CTM), to be later used if the balancing call to
      *  restore() is made. Calls to save/restore can be nested:
@@ -60,10 +76,185 @@ public:
 
     /**
      *  Fill the entire canvas with the specified color, using SRC porter-duff mode.
+     *
+     *  The whole device (or the tile being drawn, see flush() and drawDisplayList()) is
+     *  covered whatever the CTM is (the CTM still positions the shader).
+     *  Each band of rows is one blitRect, so solid kSrc fills (which includes clears) are bulk
+     *  stores over the pixel memory. Canvases of at least
+     *  kParallelMinPixels split their bands across the thread pool when setThreadCount()
+     *  allows it.
      */
     void drawPaint(const GPaint& paint) override {
-        GRect r = GRect::MakeXYWH(0, 0, fDevice.width(), fDevice.height());
-        drawRect(r, paint);
+        if (fTiled) {
+            record(my_tiled_draw::kPaint, paint, fClip, 0);
+            return;
+        }
+
+        my_blitter* blitter = makeBlitter(paint);
+        if (blitter == nullptr) return;
+
+        int bands = bandCount((int64_t) fClip.width() * fClip.height(), fParallelMinPixels);
+        fill_bands(fClip.fTop, fClip.fBottom, bands, [&](int, int y0, int y1) {
+            blitter->blitRect(fClip.fLeft, y0, fClip.width(), y1 - y0);
+        });
+    }
+
+    /**
+     *  Number of threads drawPaint and drawPath may use for very large draws. Defaults to 1 (no
+     *  threading). The paint's shader must tolerate concurrent shadeRow() calls.
+     */
+    void setThreadCount(int count) {
+        threads = std::max(count, 1);
+    }
+
+    /**
+     *  Where those threads come from (the shared pool, sized to the machine, by default) and
+     *  how big drawPaint and drawPath draws must be to use them (kParallelMinPixels and
+     *  kParallelMinPathPixels by default). Tests set these to take the threaded paths on any
+     *  machine, with any size of device.
+     */
+    void setThreadPool(my_thread_pool* pool) {
+        fPool = pool;
+    }
+
+    void setParallelThresholds(int64_t min_pixels, int64_t min_path_pixels) {
+        fParallelMinPixels = min_pixels;
+        fParallelMinPathPixels = min_path_pixels;
+    }
+
+    /**
+     *  How drawPath, drawConvexPolygon (and so drawRect, drawMesh, ...) rasterize. Defaults to
+     *  my_aa_mode::kNone, the pixel-center containment rule. With kAnalytic, edge pixels are
+     *  blended by the fraction of their area the shape covers, which replaces supersampling
+     *  the whole canvas and scaling it down. kSupersample4 / kSupersample16 estimate that
+     *  fraction from 4x4 / 16x16 samples instead: 4 is the cheap one for thumbnails, 16 is
+     *  close to analytic quality.
+     *
+     *  This is canvas state rather than part of the paint, since GPaint is fixed by the API.
+     */
+    void setAntiAlias(my_aa_mode mode) {
+        aa = mode;
+    }
+
+    // the AA mode to draw with: supersampled edges have to stay within my_edge::kMaxCoord, so
+    // devices too wide for that fall back to analytic coverage
+    my_aa_mode aaMode() const {
+        if ((width << MUsupersampleShift(aa)) > my_edge::kMaxCoord) return my_aa_mode::kAnalytic;
+        return aa;
+    }
+
+    /**
+     *  In tiled mode draws aren't rasterized as they're made. Their geometry is built (edges
+     *  or coverage lines, in device space) and binned into my_tile_bins::kTileSize square
+     *  tiles, and flush() then draws the device one tile at a time: every draw that touches
+     *  the tile, in order, clipped to it. A tile's pixels stay in cache for the whole scene,
+     *  where immediate draws each stream all of their rows through it. The pixels come out
+     *  the same either way. Analytic coverage is still summed from the device's left edge in
+     *  every tile, so wide anti-aliased shapes can cost more tiled than immediate.
+     *
+     *  The device is only up to date after flush() (or once the canvas is destroyed), so the
+     *  shaders of the paints drawn with must live until then. Turning tiled mode off flushes.
+     */
+    void setTiled(bool tiled) {
+        if (tiled == fTiled) return;
+        if (tiled) {
+            fBins.reset(width, height);
+        } else {
+            flush();
+        }
+        fTiled = tiled;
+    }
+
+    /**
+     *  Play list back on top of the CTM. Like a tiled-mode recording (setTiled), the commands
+     *  that can touch the device are built once into shapes in device space and binned, here
+     *  into kPlaybackTileSize square tiles, which up to setThreadCount() threads of the pool
+     *  (setThreadPool) then take in turn. Each thread draws through a canvas of its own,
+     *  clipped to its tile, so the pixels are the same as list.playback(this).
+     *
+     *  The threads share the list's shaders, and setContext() changes a shader, so a thread
+     *  holds a lock on the shader of the command it is drawing.
+     *
+     *  If hidden isn't null, the commands it marks are skipped: see
+     *  my_display_list::cullOccluded(), called with this canvas's CTM.
+     */
+    void drawDisplayList(const my_display_list& list, const std::vector<bool>* hidden = nullptr) {
+        drawDisplayList(list, GRect::MakeWH(width, height), hidden);
+    }
+
+    // drawDisplayList() that only redraws the pixels touching area (in device space)
+    void drawDisplayList(const my_display_list& list, const GRect& area, const std::vector<bool>* hidden = nullptr) {
+        flush();
+
+        GMatrix inverse;
+        if (!ctm.invert(&inverse)) return;
+
+        my_irect r = { (int) floorf(std::max(area.fLeft, 0.f)), (int) floorf(std::max(area.fTop, 0.f)),
+                       (int) ceilf(std::min(area.fRight, (float) width)), (int) ceilf(std::min(area.fBottom, (float) height)) };
+        if (r.isEmpty()) return;
+
+        // record the commands under r, clipped to it; AA can reach a pixel past the geometry,
+        // so look a pixel further out
+        bool tiled = fTiled;
+        fTiled = true;
+        fClip = r;
+        fBins.reset(width, height, kPlaybackTileSize);
+        std::vector<int> found;
+        list.search(MUmapRect(inverse, GRect::MakeLTRB(r.fLeft - 1, r.fTop - 1, r.fRight + 1, r.fBottom + 1)), &found);
+        for (int i : found) {
+            if (hidden != nullptr && (*hidden)[i]) continue;
+
+            size_t first = fDraws.size();
+            list.draw(this, i);
+            for (size_t k = first; k < fDraws.size(); ++k) {
+                fDraws[k].lock = list.at(i).shader;
+            }
+        }
+        fClip = deviceRect();
+
+        int tiles = fBins.count();
+        int workers = std::min(std::min(threads, pool().size()), tiles);
+        std::unique_ptr<std::mutex[]> locks(new std::mutex[list.shaderCount()]);
+        std::atomic<int> next(0);
+
+        pool().parallel_for(workers, [&](int) {
+            my_canvas canvas(fDevice);
+            canvas.aa = aa;
+            my_scratch::binding bind(canvas.fScratch);
+            for (int t = next++; t < tiles; t = next++) {
+                my_irect clip = MUintersect(fBins.tile(t), r);
+                if (!clip.isEmpty()) {
+                    canvas.drawTile(*this, t, clip, workers > 1 ? locks.get() : nullptr);
+                }
+            }
+        });
+
+        clearRecording();
+        fTiled = tiled;
+        if (tiled) {
+            fBins.reset(width, height);
+        }
+    }
+
+    /**
+     *  Draw everything recorded in tiled mode, tile by tile, and start a new recording.
+     */
+    void flush() {
+        if (fDraws.empty()) return;
+
+        // meshes replay through the immediate draws, clipped to the tile
+        fTiled = false;
+        GMatrix saved = ctm;
+        my_scratch::binding bind(fScratch);
+
+        for (int t = 0; t < fBins.count(); ++t) {
+            drawTile(*this, t, fBins.tile(t), nullptr);
+        }
+
+        fClip = deviceRect();
+        ctm = saved;
+        fTiled = true;
+        clearRecording();
     }
     
     /**
@@ -75,6 +266,11 @@ public:
      *  Any area in the rectangle that is outside of the bounds of the canvas is ignored.
      */
     void drawRect(const GRect& rect, const GPaint& paint) override {
+        if (ctm[1] == 0 && ctm[3] == 0 && aa == my_aa_mode::kNone) {
+            drawAxisAlignedRect(rect, paint);
+            return;
+        }
+
         GPoint pts[4];
         pts[0] = {rect.fLeft, rect.fTop};
         pts[1] = {rect.fRight, rect.fTop};
@@ -83,29 +279,328 @@ public:
         drawConvexPolygon(pts, 4, paint);
     }
 
-    void blit(int x0, int x1, int y, const GPaint& paint) {
-        GShader* shader = paint.getShader();
+    my_thread_pool& pool() const {
+        return fPool != nullptr ? *fPool : my_thread_pool::shared();
+    }
 
-        if (shader != nullptr) {
-            int width = x1 - x0;
-            assert(x0 >= 0 && width >= 0); // ensure row initialized correctly
-            GPixel row[width];
-            shader->shadeRow(x0, y, width, row);
-            
-            for (int x = x0; x < x1; x++) {
-                GPixel *p = fDevice.getAddr(x, y);
-                GPixel s = row[x - x0];
-                *p = MUblend(s, *p, paint.getBlendMode());
+    // how many bands to split a draw touching pixels into: 1 unless there are threads to use
+    // and at least min_pixels
+    int bandCount(int64_t pixels, int64_t min_pixels) const {
+        if (threads > 1 && pixels >= min_pixels) {
+            return std::min(threads, pool().size()) * 4;
+        }
+        return 1;
+    }
+
+    /**
+     *  Split the rows [top, bottom) into at most bands bands and run fn(band, y0, y1) over
+     *  them, with the band's scratch bound; on the pool if there is more than one.
+     */
+    void fill_bands(int top, int bottom, int bands, const std::function<void(int, int, int)>& fn) {
+        if (top >= bottom) return;
+
+        int band_height = (bottom - top + bands - 1) / bands;
+        bands = (bottom - top + band_height - 1) / band_height;
+        if (bands == 1) {
+            my_scratch::binding bind(fScratch);
+            fn(0, top, bottom);
+            return;
+        }
+
+        // each band gets its own scratch, since bands run on different threads
+        while ((int) band_scratch.size() < bands) {
+            band_scratch.emplace_back(new my_scratch(width));
+        }
+        pool().parallel_for(bands, [&](int band) {
+            my_scratch::binding bind(*band_scratch[band]);
+            int y0 = top + band * band_height;
+            fn(band, y0, std::min(y0 + band_height, bottom));
+        });
+    }
+
+    /**
+     *  drawRect() for a CTM that only translates and/or scales, so the mapped rect is still
+     *  axis-aligned. Clips the rect to the device and hands its integer bounds to blitRect,
+     *  skipping edge building and scan conversion. Rounding each side gives the same pixels
+     *  as the polygon rasterizer: a pixel is filled iff its center is inside the rect.
+     */
+    void drawAxisAlignedRect(const GRect& rect, const GPaint& paint) {
+        GPoint pts[2] = { {rect.fLeft, rect.fTop}, {rect.fRight, rect.fBottom} };
+        ctm.mapPoints(pts, pts, 2);
+
+        my_irect r = MUroundRect(pts[0], pts[1], fClip);
+        if (r.isEmpty()) return;
+
+        if (fTiled) {
+            record(my_tiled_draw::kRect, paint, r, 0);
+            return;
+        }
+
+        my_blitter* blitter = makeBlitter(paint);
+        if (blitter == nullptr) return;
+
+        my_scratch::binding bind(fScratch);
+        blitter->blitRect(r.fLeft, r.fTop, r.width(), r.height());
+    }
+
+    /**
+     *  Set up ctx for drawing with paint: reduce the paint/blend combination to the cheapest
+     *  equivalent (MUreduceBlendMode), premultiply the color, pick the row procs and give the
+     *  shader the CTM. A draw that only clears becomes a transparent kSrc fill with no shader.
+     *  Returns false if the draw can't change the device, so the caller can skip rasterizing.
+     */
+    bool makeContext(const GPaint& paint, my_draw_context* ctx) {
+        ctx->shader = paint.getShader();
+        ctx->src = MUcolorToPixel(paint.getColor());
+        ctx->opaque = ctx->shader != nullptr ? ctx->shader->isOpaque() : GPixel_GetA(ctx->src) == 255;
+
+        bool transparent = ctx->shader == nullptr && ctx->src == 0;
+        ctx->mode = MUreduceBlendMode(paint.getBlendMode(), ctx->opaque, transparent);
+
+        if (ctx->mode == GBlendMode::kDst) return false;
+
+        if (ctx->mode == GBlendMode::kClear) {
+            ctx->mode = GBlendMode::kSrc;
+            ctx->src = 0;
+            ctx->shader = nullptr;
+            ctx->opaque = false;
+        }
+
+        if (ctx->shader != nullptr) {
+            if (!(ctx->shader->setContext(ctm))) return false;
+        }
+
+        ctx->procs = MUchooseSimdBlendProcs(ctx->mode);
+        ctx->fused = dynamic_cast<my_base_shader*>(ctx->shader);
+        return true;
+    }
+
+    // add the edge p0 -> p1 (in device space scaled by 1 << shift), clipping it unless the
+    // whole shape is known to be inside the device
+    void addEdge(GPoint p0, GPoint p1, my_clip clip, int shift, std::vector<my_edge>& edges) {
+        if (clip == my_clip::kAccept) {
+            MUaddEdge(p0, p1, edges);
+        } else {
+            MUclipPoints(p0, p1, width << shift, height << shift, edges);
+        }
+    }
+
+    my_irect deviceRect() const {
+        return { 0, 0, width, height };
+    }
+
+    // the shape to build the next draw into: in tiled mode the next unused one of the
+    // recorded shapes, which drawShape() keeps for flush(). Shapes keep their capacity.
+    my_shape& newShape() {
+        if (!fTiled) return fShape;
+        if (fShapeCount == (int) fShapes.size()) {
+            fShapes.emplace_back();
+        }
+        return fShapes[fShapeCount];
+    }
+
+    /**
+     *  Build shape for the AA mode from a device-space outline: outline(shift, line) calls
+     *  line(p0, p1) for each of its lines, with the points scaled by 1 << shift. bounds (of
+     *  the unscaled outline) decides whether the edges need clipping. Returns false if the
+     *  outline can't touch a pixel of the clip.
+     *
+     *  The shape is always built against the whole device, so it fills the same pixels
+     *  whatever clip it is filled into.
+     */
+    template <typename Outline>
+    bool buildShape(my_shape& shape, const GRect& bounds, bool convex, Outline outline) {
+        my_clip clip = MUclassifyBounds(bounds, width, height);
+        shape.bounds = MUpixelBounds(bounds, fClip);
+        if (clip == my_clip::kReject || shape.bounds.isEmpty()) return false;
+
+        shape.mode = aaMode();
+        shape.shift = MUsupersampleShift(shape.mode);
+        shape.convex = convex;
+
+        if (shape.mode == my_aa_mode::kAnalytic) {
+            shape.lines.reset(width, height);
+            outline(0, [&](GPoint p0, GPoint p1) {
+                shape.lines.addLine(p0, p1);
+            });
+            shape.lines.finish();
+            return shape.lines.lines.size() > 0;
+        }
+
+        shape.edges.clear();
+        outline(shape.shift, [&](GPoint p0, GPoint p1) {
+            addEdge(p0, p1, clip, shape.shift, shape.edges);
+        });
+        MUsortEdges(shape.edges, fSortScratch);
+        return shape.edges.size() > 0;
+    }
+
+    // fill shape now, or keep it for flush() in tiled mode
+    void drawShape(const my_shape& shape, const GPaint& paint) {
+        if (fTiled) {
+            record(my_tiled_draw::kShape, paint, shape.bounds, fShapeCount++);
+            return;
+        }
+
+        my_blitter* blitter = makeBlitter(paint);
+        if (blitter == nullptr) return;
+
+        my_scratch::binding bind(fScratch);
+        fillShape(shape, blitter);
+    }
+
+    // keep a draw for flush(), binned by the pixels it can touch
+    void record(my_tiled_draw::kind_t kind, const GPaint& paint, const my_irect& bounds, int index) {
+        fBins.add((int) fDraws.size(), bounds);
+        fDraws.push_back({ kind, paint, ctm, bounds, index, -1 });
+    }
+
+    void clearRecording() {
+        fDraws.clear();
+        fMeshes.clear();
+        fShapeCount = 0;
+        fBins.clear();
+    }
+
+    /**
+     *  Draw bin t of from's recording (flush(), drawDisplayList()) inside clip, through this
+     *  canvas, which isn't in tiled mode. With locks, each draw holds its lock, if it has one.
+     */
+    void drawTile(const my_canvas& from, int t, const my_irect& clip, std::mutex locks[]) {
+        fClip = clip;
+        for (int i : from.fBins.bin(t)) {
+            const my_tiled_draw& draw = from.fDraws[i];
+            if (locks != nullptr && draw.lock >= 0) {
+                std::lock_guard<std::mutex> lock(locks[draw.lock]);
+                drawRecorded(from, draw);
+            } else {
+                drawRecorded(from, draw);
             }
+        }
+    }
+
+    void drawRecorded(const my_canvas& from, const my_tiled_draw& draw) {
+        ctm = draw.ctm;
+        if (draw.kind == my_tiled_draw::kMesh) {
+            const my_mesh& mesh = from.fMeshes[draw.index];
+            drawMesh(mesh.verts.data(), mesh.colors.empty() ? nullptr : mesh.colors.data(),
+                     mesh.texs.empty() ? nullptr : mesh.texs.data(), mesh.count, mesh.indices.data(), draw.paint);
+            return;
+        }
 
+        my_blitter* blitter = makeBlitter(draw.paint);
+        if (blitter == nullptr) return;
+
+        if (draw.kind == my_tiled_draw::kShape) {
+            fillShape(from.fShapes[draw.index], blitter);
         } else {
-            GPixel src = MUcolorToPixel(paint.getColor());
-            for (int x = x0; x < x1; ++x) {
-                GPixel *p = fDevice.getAddr(x, y);
-                *p = MUblend(src, *p, paint.getBlendMode());
+            my_irect r = MUintersect(draw.bounds, fClip);
+            if (!r.isEmpty()) {
+                blitter->blitRect(r.fLeft, r.fTop, r.width(), r.height());
             }
         }
+    }
+
+    // keep a copy of a drawMesh for flush(), which replays it in every tile it touches
+    void recordMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, const int indices[], const GPaint& paint) {
+        my_mesh mesh;
+        mesh.indices.assign(indices, indices + count * 3);
+        mesh.count = count;
+
+        int n = 0;
+        for (int i : mesh.indices) {
+            n = std::max(n, i + 1);
+        }
+        if (n == 0) return;
+        mesh.verts.assign(verts, verts + n);
+        if (colors != nullptr) mesh.colors.assign(colors, colors + n);
+        if (texs != nullptr) mesh.texs.assign(texs, texs + n);
+
+        std::vector<GPoint> pts(n);
+        ctm.mapPoints(pts.data(), verts, n);
+        my_irect bounds = MUpixelBounds(MUpointBounds(pts.data(), n), fClip);
+        if (bounds.isEmpty()) return;
+
+        fMeshes.push_back(std::move(mesh));
+        record(my_tiled_draw::kMesh, paint, bounds, (int) fMeshes.size() - 1);
+    }
+
+    /**
+     *  Pick the blitter for paint and set it up for this draw, or return null if the draw
+     *  can't change the device.
+     */
+    my_blitter* makeBlitter(const GPaint& paint) {
+        my_draw_context ctx;
+        return makeBlitter(paint, &ctx);
+    }
+
+    // makeBlitter() that also hands back the context it set up
+    my_blitter* makeBlitter(const GPaint& paint, my_draw_context* ctx) {
+        if (!makeContext(paint, ctx)) return nullptr;
+
+        my_blitter* blitter;
+        if (ctx->shader == nullptr) {
+            blitter = ctx->procs.copiesSrc ? (my_blitter*) &fSolidCopyBlitter : &fSolidBlitter;
+        } else {
+            blitter = ctx->procs.copiesSrc ? (my_blitter*) &fShaderCopyBlitter : &fShaderBlitter;
+        }
+        blitter->setContext(*ctx);
+        return blitter;
+    }
+
+    // hand the span [x0, x1) of row y to the blitter, clamped to the clip (edges are only
+    // clipped in y, see MUclipPoints), dropping empty ones
+    void blit(my_blitter* blitter, int x0, int x1, int y) {
+        x0 = std::max(x0, fClip.fLeft);
+        x1 = std::min(x1, fClip.fRight);
+        if (x0 >= x1) return;
+        blitter->blitH(x0, y, x1 - x0);
+    }
+
+    // fill shape inside fClip
+    void fillShape(const my_shape& shape, my_blitter* blitter) {
+        if (shape.mode == my_aa_mode::kAnalytic) {
+            fillCoverage(shape.lines, blitter);
+        } else if (shape.shift > 0) {
+            fillSupersampled(shape.edges, shape.shift, blitter);
+        } else if (shape.convex) {
+            convex_scan(shape.edges, blitter);
+        } else {
+            complex_scan(shape, blitter);
+        }
+    }
+
+    // rasterize lines inside fClip, blending by coverage
+    void fillCoverage(const my_aa_lines& lines, my_blitter* blitter) {
+        fRows.reset(width, fClip.fLeft, fClip.fRight);
+        fAA.rasterize(lines, fClip.fTop, fClip.fBottom, fClip.fRight, fRows, [blitter](const uint8_t mask[], size_t rowBytes, int x, int y, int w, int h) {
+            blitter->blitMask(mask, rowBytes, x, y, w, h);
+        });
+    }
 
+    /**
+     *  Scan edges built in supersampled space (device scaled by 1 << shift) and blend each
+     *  pixel row inside fClip by the share of its samples the spans of its sub-scanlines cover.
+     */
+    void fillSupersampled(const std::vector<my_edge>& edges, int shift, my_blitter* blitter) {
+        auto blit_mask = [blitter](const uint8_t mask[], size_t rowBytes, int x, int y, int w, int h) {
+            blitter->blitMask(mask, rowBytes, x, y, w, h);
+        };
+        int left = fClip.fLeft << shift;
+        int right = fClip.fRight << shift;
+
+        fMask.reset(width, shift);
+        fRows.reset(width, fClip.fLeft, fClip.fRight);
+        int row = edges.front().top >> shift;
+        walk_edges(edges, fClip.fTop << shift, fClip.fBottom << shift, fActive, [&](int y, int x0, int x1) {
+            if (y >> shift != row) {
+                fMask.flush(row, fRows, blit_mask);
+                row = y >> shift;
+            }
+            fMask.addSpan(std::max(x0, left), std::min(x1, right));
+        });
+        fMask.flush(row, fRows, blit_mask);
+        fRows.flush(blit_mask);
     }
 
     /**
@@ -116,102 +611,244 @@ public:
 
         // build edges. sort. ray cast/draw.
 
-        GShader* shader = paint.getShader();
-        if (shader != nullptr) {
-            if (!(shader->setContext(ctm))) return;
-        }
-
         GPoint matrix_pts[count];
         ctm.mapPoints(matrix_pts, points, count); // map points
 
-        std::vector<my_edge> edges;
+        const GPoint* pts = matrix_pts;     // lambdas can't capture the array itself
+        my_shape& shape = newShape();
+        bool built = buildShape(shape, MUpointBounds(pts, count), true, [&](int shift, auto line) {
+            float scale = (float) (1 << shift);
+            for (int i = 0; i < count; i++) {
+                line(pts[i] * scale, pts[(i + 1) % count] * scale);
+            }
+        });
+        if (built) {
+            drawShape(shape, paint);
+        }
+    }
 
-        for (int i = 0; i < count - 1; i++) { // clip points for each point pair except last
-            MUclipPoints(matrix_pts[i], matrix_pts[i+1], width, height, edges);
+    /**
+     *  Draw count rects with paint: the same pixels as count drawRect() calls. If colors isn't
+     *  null, rect i is drawn with colors[i] in place of the paint's color (which a shader
+     *  ignores, as in drawRect).
+     *
+     *  For charts and heatmaps made of many small rects: the paint is set up once (again only
+     *  when the color changes), every corner is mapped in one mapPoints() call, and the fills
+     *  run back to back through the same blitter and scratch.
+     */
+    void drawRects(const GRect rects[], int count, const GPaint& paint, const GColor colors[] = nullptr) {
+        if (count <= 0) return;
+
+        if (ctm[1] != 0 || ctm[3] != 0 || aa != my_aa_mode::kNone) {
+            // the polygons drawRect would draw
+            fBatchPoints.resize(count * 4);
+            for (int i = 0; i < count; ++i) {
+                const GRect& r = rects[i];
+                GPoint* pts = &fBatchPoints[i * 4];
+                pts[0] = {r.fLeft, r.fTop};
+                pts[1] = {r.fRight, r.fTop};
+                pts[2] = {r.fRight, r.fBottom};
+                pts[3] = {r.fLeft, r.fBottom};
+            }
+            fBatchCounts.assign(count, 4);
+            ctm.mapPoints(fBatchPoints.data(), fBatchPoints.data(), count * 4);
+            fillConvexPolygons(fBatchPoints.data(), fBatchCounts.data(), count, paint, colors);
+            return;
         }
-        MUclipPoints(matrix_pts[count-1], matrix_pts[0], width, height, edges);
 
-        if (edges.size() == 0) return;
+        // drawAxisAlignedRect, from two corners per rect
+        fBatchPoints.resize(count * 2);
+        for (int i = 0; i < count; ++i) {
+            fBatchPoints[i * 2] = {rects[i].fLeft, rects[i].fTop};
+            fBatchPoints[i * 2 + 1] = {rects[i].fRight, rects[i].fBottom};
+        }
+        ctm.mapPoints(fBatchPoints.data(), fBatchPoints.data(), count * 2);
 
-        MUsortEdges(edges);
+        my_batch_blitter batch(this, paint, colors);
+        my_scratch::binding bind(fScratch);
+        for (int i = 0; i < count; ++i) {
+            my_irect r = MUroundRect(fBatchPoints[i * 2], fBatchPoints[i * 2 + 1], fClip);
+            if (r.isEmpty()) continue;
 
-        // ray cast here (blit)
-        int min_y = edges.front().top;
-        int max_y = edges.back().bottom;
-        
-        int L = 0;
-        int R = 1;
-        int next_edge = 2;
+            if (fTiled) {
+                record(my_tiled_draw::kRect, batch.paint(i), r, 0);
+                continue;
+            }
+            my_blitter* blitter = batch.get(i);
+            if (blitter != nullptr) {
+                blitter->blitRect(r.fLeft, r.fTop, r.width(), r.height());
+            }
+        }
+    }
+
+    /**
+     *  Draw polygons convex polygons with paint, polygon i made of the next counts[i] points:
+     *  the same pixels as a drawConvexPolygon() call per polygon. colors works as for
+     *  drawRects(), and so does the batching.
+     */
+    void drawConvexPolygons(const GPoint points[], const int counts[], int polygons, const GPaint& paint, const GColor colors[] = nullptr) {
+        int total = 0;
+        for (int i = 0; i < polygons; ++i) {
+            total += counts[i];
+        }
+        if (total <= 0) return;
+
+        fBatchPoints.resize(total);
+        ctm.mapPoints(fBatchPoints.data(), points, total);
+        fillConvexPolygons(fBatchPoints.data(), counts, polygons, paint, colors);
+    }
 
-        for (int y = min_y; y < max_y; ++y) {
+    // drawConvexPolygons() for points already in device space
+    void fillConvexPolygons(const GPoint points[], const int counts[], int polygons, const GPaint& paint, const GColor colors[]) {
+        my_batch_blitter batch(this, paint, colors);
+        my_scratch::binding bind(fScratch);
+        const GPoint* pts = points;
+        for (int i = 0; i < polygons; pts += counts[i++]) {
+            int count = counts[i];
+            if (count <= 0) continue;
+
+            my_shape& shape = newShape();
+            bool built = buildShape(shape, MUpointBounds(pts, count), true, [&](int shift, auto line) {
+                float scale = (float) (1 << shift);
+                for (int j = 0; j < count; j++) {
+                    line(pts[j] * scale, pts[(j + 1) % count] * scale);
+                }
+            });
+            if (!built) continue;
 
-            my_edge e_L = edges.at(L);
-            my_edge e_R = edges.at(R);
+            if (fTiled) {
+                drawShape(shape, batch.paint(i));
+                continue;
+            }
+            my_blitter* blitter = batch.get(i);
+            if (blitter != nullptr) {
+                fillShape(shape, blitter);
+            }
+        }
+    }
+
+    /**
+     *  Scan the edges of a convex polygon inside fClip: every row has one left and one right
+     *  edge, and a finished edge is replaced by the next one in order.
+     */
+    void convex_scan(const std::vector<my_edge>& edges, my_blitter* blitter) {
+        if (edges.size() < 2) return;
+
+        // copies, since edges can be scanned again for another clip
+        my_edge e_L = edges[0];
+        my_edge e_R = edges[1];
+        size_t next_edge = 2;
+
+        int max_y = std::min(edges.back().bottom, fClip.fBottom);
+        for (int y = edges.front().top; y < max_y; ++y) {
 
             // blit
-            blit(e_L.get_X(y), e_R.get_X(y), y, paint);     
+            if (y >= fClip.fTop) {
+                blit(blitter, e_L.get_X(), e_R.get_X(), y);
+            }
 
             // is next edge valid
 
             if (e_L.valid(y+1) == false) {
-                L = next_edge;
-                next_edge++;
-                if (L >= edges.size()) return;
+                if (next_edge >= edges.size()) return;
+                e_L = edges[next_edge++];
+            } else {
+                e_L.step();
             }
 
             if (e_R.valid(y+1) == false) {
-                R = next_edge;
-                next_edge++;
-                if (R >= edges.size()) return;
+                if (next_edge >= edges.size()) return;
+                e_R = edges[next_edge++];
+            } else {
+                e_R.step();
             }
-        }   
+        }
     }
 
-    void complex_scan(std::vector<my_edge> edges, const GPaint& paint) {
+    /**
+     *  Scan a path's edges inside fClip. Paths covering at least kParallelMinPathPixels split
+     *  their rows into bands across the thread pool when setThreadCount() allows it. Every
+     *  band walks the shared edges from its own first row with an active list of its own, so
+     *  the pixels are the same as a walk over all the rows on one thread.
+     */
+    void complex_scan(const my_shape& shape, my_blitter* blitter) {
+        my_irect r = MUintersect(shape.bounds, fClip);
+        int bands = bandCount((int64_t) r.width() * r.height(), fParallelMinPathPixels);
+        while ((int) band_active.size() < bands) {
+            band_active.emplace_back();
+        }
+
+        fill_bands(r.fTop, r.fBottom, bands, [&](int band, int y0, int y1) {
+            std::vector<my_edge>& active = bands == 1 ? fActive : band_active[band];
+            walk_edges(shape.edges, y0, y1, active, [&](int y, int x0, int x1) {
+                blit(blitter, x0, x1, y);
+            });
+        });
+    }
+
+    /**
+     *  Walk edges (sorted by MUsortEdges) down the rows [top, bottom) with non-zero winding,
+     *  calling span(y, x0, x1) for every run of pixels inside.
+     *
+     *  The active edges live in their own list (active), kept sorted in x: edges join it from edges
+     *  (pending, in order of top) on their first row, finished ones are compacted out while
+     *  walking a row, and the insertion sort after stepping only has to fix the few edges that
+     *  crossed since the last row. Edges that start above top join on row top, moved straight
+     *  there (my_edge::stepTo), so a walk over part of the rows gives the same spans as the
+     *  same rows of a full walk.
+     */
+    template <typename Span>
+    void walk_edges(const std::vector<my_edge>& edges, int top, int bottom, std::vector<my_edge>& active, Span span) {
         assert(edges.size() > 0);
 
+        active.clear();
+        size_t next = 0;
         int x0, x1;
         // loop through all y’s containing edges
-        int y = edges.at(0).top;
-        while (edges.size() > 0) {
-            int index = 0;
+        int y = std::max(edges.front().top, top);
+        while (next < edges.size() || active.size() > 0) {
+            if (active.size() == 0) {
+                y = std::max(y, edges[next].top);
+            }
+            if (y >= bottom) break;
+
+            // pull in the edges that start on this row (or above it, on the first row)
+            while (next < edges.size() && edges[next].top <= y) {
+                const my_edge& e = edges[next++];
+                if (e.bottom <= y) continue;
+                active.push_back(e);
+                active.back().stepTo(y);
+            }
+            MUinsertionSortInX(active);
+
             int w = 0;
+            size_t live = 0;
+            for (size_t i = 0; i < active.size(); ++i) {
+                my_edge& e = active[i];
 
-            // loop through active edges
-            while (index < edges.size() && edges.at(index).top <= y) {                
                 // check w (for left) → did we go from 0 to non-0
                 if (w == 0) {
-                    x0 = edges.at(index).get_X(y);
+                    x0 = e.get_X();
                 }
 
                 // update w → w += edge[index].winding
-                w += edges.at(index).winding;
+                w += e.winding;
 
                 // check w (for right and blit) → did we go from non-0 to 0
                 if (w == 0) {
-                    x1 = edges.at(index).get_X(y);
-                    blit(x0, x1, y, paint);
+                    x1 = e.get_X();
+                    span(y, x0, x1);
                 }
 
-                // if the edge is done, remove from array
-                // else update currX by slope (and ++index)
-                if (edges.at(index).valid(y+1) == false) {
-                    edges.erase(edges.begin() + index);
-                } else {
-                    edges.at(index).curr_x += edges.at(index).m;
-                    ++index;
+                // keep the edge if it continues, stepped to the next row
+                if (e.valid(y+1)) {
+                    e.step();
+                    active[live++] = e;
                 }
             }
+            active.resize(live);
 
             y++;
-            
-            // move index to include edges that will be valid
-            while (index < edges.size() && y == edges.at(index).top) {
-                index += 1;
-            }
-
-            // sort edge[] from [0...index) based solely on currX
-            MUsortInX(edges, index);
         }
     }
 
@@ -219,63 +856,27 @@ public:
 
     /**
      *  Fill the path with the paint, interpreting the path using winding-fill (non-zero winding).
+     *
+     *  Paths whose mapped bounds miss the device are rejected before any work; paths entirely
+     *  inside it skip edge clipping. Large paths scan in bands on several threads when
+     *  setThreadCount() allows (see complex_scan).
      */
     void drawPath(const GPath& path, const GPaint& paint) override {
 
-        GPath p = path;
-
-        GShader* shader = paint.getShader();
-        if (shader != nullptr) {
-            if (!(shader->setContext(ctm))) return;
-        }
-
-        p.transform(ctm);
-
-        std::vector<my_edge> edges;
-        GPoint next_pts[4];
-        GPath::Edger edger = GPath::Edger(p);
-        GPath::Verb v = edger.next(next_pts);
-
-        while (v != GPath::Verb::kDone) {
-            switch (v) {
-                case GPath::Verb::kLine : {
-                    MUclipPoints(next_pts[0], next_pts[1], width, height, edges);
-                    break;
-                }
-                case GPath::Verb::kCubic : {
-                    int k = MUcomputeCubicSegments(next_pts);
-                    GPoint p0 = next_pts[0];
-                    for (int i = 1; i < k; ++i) {
-                        float t = (float) i / k;
-                        GPoint p1 = MUevalCubic(next_pts, t);
-                        MUclipPoints(p0, p1, width, height, edges);
-                        p0 = p1;
-                    }
-                    MUclipPoints(p0, next_pts[3], width, height, edges);
-                    break;
-                }
-                case GPath::Verb::kQuad : {
-                    int k = MUcomputeQuadSegments(next_pts);
-                    GPoint p0 = next_pts[0];
-                    for (int i = 1; i < k; ++i) {
-                        float t = (float) i / k;
-                        GPoint p1 = MUevalQuad(next_pts, t);
-                        MUclipPoints(p0, p1, width, height, edges);
-                        p0 = p1;
-                    }
-                    MUclipPoints(p0, next_pts[2], width, height, edges);
-                    break;
-                }
-                default : break;
+        // the control points bound the path, so their mapped bounds decide the clipping
+        my_shape& shape = newShape();
+        bool built = buildShape(shape, MUmapRect(ctm, path.bounds()), false, [&](int shift, auto line) {
+            GPath& p = fPath;
+            p = path;
+            p.transform(ctm);
+            if (shift > 0) {
+                p.transform(GMatrix::Scale(1 << shift, 1 << shift));
             }
-            v = edger.next(next_pts);
+            MUflattenPath(p, line);
+        });
+        if (built) {
+            drawShape(shape, paint);
         }
-
-        if (edges.size() == 0) return;
-
-        MUsortEdges(edges);
-
-        complex_scan(edges, paint);     
     }
 
     // PA6
@@ -341,7 +942,11 @@ public:
      */
     // GPoint verts[], GColor colors[], GPoint texs[], int count, int indices[], GPaint& paint
     void drawMesh(const GPoint verts[], const GColor _colors[], const GPoint _texs[], int count, const int indices[], const GPaint& paint) {
-        
+        if (fTiled) {
+            recordMesh(verts, _colors, _texs, count, indices, paint);
+            return;
+        }
+
         int n = 0;
 
         for (int i = 0; i < count; ++i) {
@@ -467,11 +1072,102 @@ public:
     }
 
 private:
+    /**
+     *  The blitters of a batch drawn with paint, or with colors[i] in place of its color for
+     *  item i. The paint is only set up again when the item's color differs from the last
+     *  one (and then only the color if it can be), and never with a shader, which ignores
+     *  the colors.
+     */
+    class my_batch_blitter {
+    public:
+        my_batch_blitter(my_canvas* canvas, const GPaint& paint, const GColor colors[])
+            : fCanvas(canvas), fPaint(paint), fColors(paint.getShader() == nullptr ? colors : nullptr) {}
+
+        // the paint of item i
+        GPaint paint(int i) const {
+            GPaint p = fPaint;
+            if (fColors != nullptr) p.setColor(fColors[i]);
+            return p;
+        }
+
+        // the blitter for item i, or null if it can't change the device
+        my_blitter* get(int i) {
+            if (fColors == nullptr) {
+                if (!fReady) fBlitter = fCanvas->makeBlitter(fPaint);
+                fReady = true;
+                return fBlitter;
+            }
+            GPixel src = MUcolorToPixel(fColors[i]);
+            if (fReady && src == fSrc) return fBlitter;
+
+            // a color as (non-)opaque as the last one, neither transparent, reduces to the same
+            // mode and procs, so only the color in the context changes (unless the mode made
+            // it draw zeros, see makeContext)
+            bool same_kind = (GPixel_GetA(src) == 255) == (GPixel_GetA(fSrc) == 255) && src != 0 && fSrc != 0;
+            if (fReady && fBlitter != nullptr && same_kind && fCtx.src == fSrc) {
+                fCtx.src = src;
+                fBlitter->setContext(fCtx);
+            } else {
+                fBlitter = fCanvas->makeBlitter(paint(i), &fCtx);
+            }
+            fSrc = src;
+            fReady = true;
+            return fBlitter;
+        }
+
+    private:
+        my_canvas* fCanvas;
+        const GPaint& fPaint;
+        const GColor* fColors;
+        my_blitter* fBlitter = nullptr;
+        my_draw_context fCtx;           // what fBlitter was set up with
+        GPixel fSrc = 0;
+        bool fReady = false;
+    };
+
+    static const int kParallelMinPixels = 7680 * 4320;  // 8K
+    // analytic coverage is summed from the device's left edge in every tile, so wide shapes
+    // cost less in these than in my_tile_bins tiles; and there are still plenty to share out
+    static const int kPlaybackTileSize = 256;
+    // a path this size takes milliseconds to scan, far more than waking the pool
+    static const int kParallelMinPathPixels = 512 * 512;
+
     const GBitmap fDevice;
     const int width;
     const int height;
     GMatrix ctm;
     std::stack<GMatrix> saves;
+    int threads = 1;
+    my_thread_pool* fPool = nullptr;    // setThreadPool(), or the shared pool if null
+    int64_t fParallelMinPixels = kParallelMinPixels;
+    int64_t fParallelMinPathPixels = kParallelMinPathPixels;
+    my_aa_mode aa = my_aa_mode::kNone;
+    my_irect fClip;                 // pixels draws may touch: the device, or the tile being flushed
+    my_coverage_rasterizer fAA;
+    my_supersample_mask fMask;
+    my_coverage_mask fRows;         // AA coverage on its way to blitMask, fAA or fMask writes it
+    my_shape fShape;                // the current draw's shape, when not tiled
+    std::vector<my_edge> fActive;   // active edges of walk_edges
+    my_edge_sort_scratch fSortScratch;
+    GPath fPath;                    // drawPath's copy of the path in device space
+    my_scratch fScratch;
+    my_solid_blitter fSolidBlitter;
+    my_solid_copy_blitter fSolidCopyBlitter;
+    my_shader_blitter fShaderBlitter;
+    my_shader_copy_blitter fShaderCopyBlitter;
+    std::vector<std::unique_ptr<my_scratch>> band_scratch;
+    std::vector<std::vector<my_edge>> band_active;
+
+    std::vector<GPoint> fBatchPoints;   // drawRects / drawConvexPolygons in device space
+    std::vector<int> fBatchCounts;
+
+    // tiled mode (setTiled)
+    bool fTiled = false;
+    std::vector<my_tiled_draw> fDraws;
+    std::vector<my_shape> fShapes;  // fShapeCount of them recorded, the rest kept for reuse
+    int fShapeCount = 0;
+    std::vector<my_mesh> fMeshes;
+    my_tile_bins fBins;
 };
 
 /**
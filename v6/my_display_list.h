@@ -0,0 +1,391 @@
+#ifndef my_display_list_DEFINED
+#define my_display_list_DEFINED
+
+#include "include/GCanvas.h"
+#include "include/GColor.h"
+#include "include/GMatrix.h"
+#include "include/GPaint.h"
+#include "include/GPath.h"
+#include "include/GPoint.h"
+#include "include/GRect.h"
+#include "include/GShader.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <mutex>
+#include <stack>
+#include <unordered_map>
+#include <vector>
+
+#include "my_utils.h"
+#include "my_bvh.h"
+
+/**
+ *  A recorded scene (my_recording_canvas) that can be played back into any canvas, any
+ *  number of times.
+ *
+ *  save / restore / concat aren't kept: each command refers to the CTM it was drawn with, so
+ *  commands can be played back on their own, in any subset. Geometry lives in a few shared
+ *  pools, each command only keeping where its part starts.
+ *
+ *  Each command also keeps its bounds in the recording's device space, and search() finds
+ *  the commands inside an area through a my_bvh over them, built on the first search after
+ *  a recording; so drawing a viewport or a dirty tile costs what's in it, not the scene.
+ *
+ *  Paints keep their shader pointers, so shaders must outlive every playback.
+ */
+class my_display_list {
+public:
+    enum kind_t {
+        kPaint,
+        kRect,
+        kConvexPolygon,
+        kPath,
+        kMesh,
+        kQuad,
+    };
+
+    struct command {
+        kind_t kind;
+        int matrix;     // into matrices
+        int shader;     // into shaders, or -1 if the paint has none
+        GPaint paint;
+        GRect rect;     // kRect
+        int points;     // into points: kConvexPolygon, kMesh and kQuad
+        int count;      // points of a kConvexPolygon, triangles of a kMesh, level of a kQuad
+        int colors;     // into colors, or -1: kMesh and kQuad
+        int texs;       // into points, or -1: kMesh and kQuad
+        int indices;    // into indices: kMesh
+        int path;       // into paths: kPath
+        GRect bounds;   // in device space, before the playback CTM; unbounded for kPaint
+    };
+
+    int count() const {
+        return (int) commands.size();
+    }
+
+    const command& at(int i) const {
+        return commands[i];
+    }
+
+    // the distinct shaders the commands' paints use
+    int shaderCount() const {
+        return (int) shaders.size();
+    }
+
+    void reset() {
+        commands.clear();
+        matrices.clear();
+        shaders.clear();
+        shader_index.clear();
+        points.clear();
+        colors.clear();
+        indices.clear();
+        paths.clear();
+        bounds.clear();
+        indexed = -1;
+        resets++;
+    }
+
+    /**
+     *  Set found to the commands whose bounds intersect area, in drawing order. Safe to call
+     *  from several threads at once, as long as nothing is being recorded.
+     */
+    void search(const GRect& area, std::vector<int>* found) const {
+        {
+            std::lock_guard<std::mutex> lock(index_lock);
+            if (indexed != count()) {
+                index.build(bounds);
+                indexed = count();
+            }
+        }
+        found->clear();
+        index.search(area, [found](int i) { found->push_back(i); });
+        std::sort(found->begin(), found->end());
+    }
+
+    /**
+     *  Set hidden[i] for each command that can't show when played back under ctm, because
+     *  every pixel it can touch is then overwritten by a later axis-aligned rect: one drawn
+     *  with kSrc, or with kSrcOver and an opaque color or shader (anything MUreduceBlendMode
+     *  turns into kSrc or kClear). Returns how many are hidden. The list itself is left alone,
+     *  so it can still be played back under any CTM; hidden only holds for this one.
+     *
+     *  Pixels are judged conservatively, so the result holds in every my_aa_mode: a rect only
+     *  hides the pixels entirely inside it, which every mode covers fully however far the rect
+     *  reaches past the device (tests/aa_test.cpp), and a command may touch a pixel beyond its
+     *  bounds. Only the kMaxOccluders largest rects are kept as occluders.
+     */
+    int cullOccluded(const GMatrix& ctm, std::vector<bool>* hidden) const {
+        std::vector<GRect> occluders;   // the pixels each hides, in device space
+        hidden->assign(commands.size(), false);
+        int culled = 0;
+
+        for (int i = count() - 1; i >= 0; --i) {
+            const command& c = commands[i];
+            GRect r = MUmapRect(ctm, c.bounds);
+            GRect touched = GRect::MakeLTRB(floorf(r.fLeft) - 1, floorf(r.fTop) - 1, ceilf(r.fRight) + 1, ceilf(r.fBottom) + 1);
+            bool covered = false;
+            for (const GRect& o : occluders) {
+                if (contains(o, touched)) {
+                    covered = true;
+                    break;
+                }
+            }
+            if (covered) {
+                (*hidden)[i] = true;
+                ++culled;
+                continue;
+            }
+
+            GMatrix m = ctm * matrices[c.matrix];
+            if (c.kind != kRect || m[1] != 0 || m[3] != 0 || !overwrites(c.paint)) continue;
+
+            r = MUmapRect(m, c.rect);
+            GRect inside = GRect::MakeLTRB(ceilf(r.fLeft), ceilf(r.fTop), floorf(r.fRight), floorf(r.fBottom));
+            if (inside.fLeft >= inside.fRight || inside.fTop >= inside.fBottom) continue;
+            if ((int) occluders.size() < kMaxOccluders) {
+                occluders.push_back(inside);
+            } else {
+                auto smallest = std::min_element(occluders.begin(), occluders.end(), [](const GRect& a, const GRect& b) {
+                    return area(a) < area(b);
+                });
+                if (area(*smallest) < area(inside)) *smallest = inside;
+            }
+        }
+        return culled;
+    }
+
+    // draw every command into canvas, in order, on top of its CTM
+    void playback(GCanvas* canvas) const {
+        for (int i = 0; i < count(); ++i) {
+            draw(canvas, i);
+        }
+    }
+
+    // draw the commands not hidden (see cullOccluded()) into canvas, in order
+    void playback(GCanvas* canvas, const std::vector<bool>& hidden) const {
+        for (int i = 0; i < count(); ++i) {
+            if (!hidden[i]) draw(canvas, i);
+        }
+    }
+
+    // draw the commands that can touch area (in the recording's device space) into canvas
+    void playback(GCanvas* canvas, const GRect& area) const {
+        std::vector<int> found;
+        search(area, &found);
+        for (int i : found) {
+            draw(canvas, i);
+        }
+    }
+
+    // draw command i into canvas, on top of its CTM
+    void draw(GCanvas* canvas, int i) const {
+        const command& c = commands[i];
+        canvas->save();
+        canvas->concat(matrices[c.matrix]);
+        switch (c.kind) {
+            case kPaint:
+                canvas->drawPaint(c.paint);
+                break;
+            case kRect:
+                canvas->drawRect(c.rect, c.paint);
+                break;
+            case kConvexPolygon:
+                canvas->drawConvexPolygon(&points[c.points], c.count, c.paint);
+                break;
+            case kPath:
+                canvas->drawPath(paths[c.path], c.paint);
+                break;
+            case kMesh:
+                canvas->drawMesh(&points[c.points], c.colors < 0 ? nullptr : &colors[c.colors],
+                                 c.texs < 0 ? nullptr : &points[c.texs], c.count, &indices[c.indices], c.paint);
+                break;
+            case kQuad:
+                canvas->drawQuad(&points[c.points], c.colors < 0 ? nullptr : &colors[c.colors],
+                                 c.texs < 0 ? nullptr : &points[c.texs], c.count, c.paint);
+                break;
+        }
+        canvas->restore();
+    }
+
+private:
+    friend class my_recording_canvas;
+
+    static const int kMaxOccluders = 16;
+
+    static bool contains(const GRect& outer, const GRect& inner) {
+        return outer.fLeft <= inner.fLeft && outer.fTop <= inner.fTop && outer.fRight >= inner.fRight && outer.fBottom >= inner.fBottom;
+    }
+
+    static float area(const GRect& r) {
+        return (r.fRight - r.fLeft) * (r.fBottom - r.fTop);
+    }
+
+    // true if filling with paint replaces every pixel it fully covers (see makeContext)
+    static bool overwrites(const GPaint& paint) {
+        GShader* shader = paint.getShader();
+        GPixel src = MUcolorToPixel(paint.getColor());
+        bool opaque = shader != nullptr ? shader->isOpaque() : GPixel_GetA(src) == 255;
+        bool transparent = shader == nullptr && src == 0;
+        GBlendMode mode = MUreduceBlendMode(paint.getBlendMode(), opaque, transparent);
+        return mode == GBlendMode::kSrc || mode == GBlendMode::kClear;
+    }
+
+    // a new command of kind drawn with paint under matrices[matrix] inside bounds, for the
+    // caller to finish
+    command& add(kind_t kind, int matrix, const GPaint& paint, const GRect& r) {
+        command c;
+        c.kind = kind;
+        c.matrix = matrix;
+        c.shader = -1;
+        c.paint = paint;
+        c.rect = GRect::MakeLTRB(0, 0, 0, 0);
+        c.points = c.count = c.indices = c.path = 0;
+        c.colors = c.texs = -1;
+        c.bounds = r;
+        bounds.push_back(r);
+
+        GShader* shader = paint.getShader();
+        if (shader != nullptr) {
+            auto found = shader_index.find(shader);
+            if (found == shader_index.end()) {
+                found = shader_index.emplace(shader, (int) shaders.size()).first;
+                shaders.push_back(shader);
+            }
+            c.shader = found->second;
+        }
+
+        commands.push_back(c);
+        return commands.back();
+    }
+
+    // append count points (if pts isn't null) and return where they start
+    int addPoints(const GPoint pts[], int count) {
+        if (pts == nullptr) return -1;
+        int start = (int) points.size();
+        points.insert(points.end(), pts, pts + count);
+        return start;
+    }
+
+    int addColors(const GColor cs[], int count) {
+        if (cs == nullptr) return -1;
+        int start = (int) colors.size();
+        colors.insert(colors.end(), cs, cs + count);
+        return start;
+    }
+
+    std::vector<command> commands;
+    std::vector<GMatrix> matrices;
+    std::vector<GShader*> shaders;
+    std::unordered_map<GShader*, int> shader_index;
+    std::vector<GPoint> points;
+    std::vector<GColor> colors;
+    std::vector<int> indices;
+    std::vector<GPath> paths;
+    std::vector<GRect> bounds;          // each command's bounds, what index is built over
+    int resets = 0;                     // reset() calls, so recorders know their matrix is gone
+
+    mutable my_bvh index;
+    mutable int indexed = -1;           // how many commands index covers, -1 if it's stale
+    mutable std::mutex index_lock;
+};
+
+/**
+ *  A canvas that records its draws into a my_display_list instead of drawing them.
+ *  save / restore / concat only track the CTM; a draw stores the CTM it's made with, which
+ *  is only added to the list again after it changes.
+ */
+class my_recording_canvas : public GCanvas {
+public:
+    explicit my_recording_canvas(my_display_list* list) : fList(list) {}
+
+    void save() override {
+        saves.push(ctm);
+    }
+
+    void restore() override {
+        ctm = saves.top();
+        saves.pop();
+        matrix = -1;
+    }
+
+    void concat(const GMatrix& m) override {
+        ctm = ctm * m;
+        matrix = -1;
+    }
+
+    void drawPaint(const GPaint& paint) override {
+        fList->add(my_display_list::kPaint, currentMatrix(), paint, GRect::MakeLTRB(-FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX));
+    }
+
+    void drawRect(const GRect& rect, const GPaint& paint) override {
+        fList->add(my_display_list::kRect, currentMatrix(), paint, MUmapRect(ctm, rect)).rect = rect;
+    }
+
+    void drawConvexPolygon(const GPoint points[], int count, const GPaint& paint) override {
+        if (count <= 0) return;
+        my_display_list::command& c = fList->add(my_display_list::kConvexPolygon, currentMatrix(), paint, deviceBounds(points, count));
+        c.points = fList->addPoints(points, count);
+        c.count = count;
+    }
+
+    void drawPath(const GPath& path, const GPaint& paint) override {
+        my_display_list::command& c = fList->add(my_display_list::kPath, currentMatrix(), paint, MUmapRect(ctm, path.bounds()));
+        c.path = (int) fList->paths.size();
+        fList->paths.push_back(path);
+    }
+
+    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, const int indices[], const GPaint& paint) override {
+        // only keep the vertices the triangles use
+        int n = 0;
+        for (int i = 0; i < count * 3; ++i) {
+            n = std::max(n, indices[i] + 1);
+        }
+        if (n == 0) return;
+
+        my_display_list::command& c = fList->add(my_display_list::kMesh, currentMatrix(), paint, deviceBounds(verts, n));
+        c.points = fList->addPoints(verts, n);
+        c.colors = fList->addColors(colors, n);
+        c.texs = fList->addPoints(texs, n);
+        c.count = count;
+        c.indices = (int) fList->indices.size();
+        fList->indices.insert(fList->indices.end(), indices, indices + count * 3);
+    }
+
+    void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level, const GPaint& paint) override {
+        my_display_list::command& c = fList->add(my_display_list::kQuad, currentMatrix(), paint, deviceBounds(verts, 4));
+        c.points = fList->addPoints(verts, 4);
+        c.colors = fList->addColors(colors, 4);
+        c.texs = fList->addPoints(texs, 4);
+        c.count = level;
+    }
+
+private:
+    // index of the CTM in the list's matrices, adding it if it changed since the last draw
+    // or the list was reset since
+    int currentMatrix() {
+        if (matrix < 0 || resets != fList->resets) {
+            matrix = (int) fList->matrices.size();
+            fList->matrices.push_back(ctm);
+            resets = fList->resets;
+        }
+        return matrix;
+    }
+
+    // bounds of pts mapped through the CTM
+    GRect deviceBounds(const GPoint pts[], int count) {
+        mapped.resize(count);
+        ctm.mapPoints(mapped.data(), pts, count);
+        return MUpointBounds(mapped.data(), count);
+    }
+
+    my_display_list* fList;
+    GMatrix ctm;
+    std::stack<GMatrix> saves;
+    int matrix = -1;    // index of ctm in the list's matrices, -1 if not added yet
+    int resets = 0;     // fList->resets when matrix was added
+    std::vector<GPoint> mapped;
+};
+
+#endif
@@ -5,6 +5,10 @@
 #include "include/GPoint.h"
 #include "include/GMath.h"
 
+#include <stdint.h>
+#include <algorithm>
+#include <math.h>
+
 struct my_edge {
 
     // x = m*y + b
@@ -13,10 +17,18 @@ struct my_edge {
     // y = (x-b)/m
 
     float m, b;
-    float curr_x;
     int top, bottom;
     int winding;
 
+    // x at the center of the current row and its change per row, in 32.32 fixed point.
+    // Starts at row top; the scan converters step() it once per row. 32 fractional bits
+    // keep the slope's rounding error far below a float's, so get_X() can round x exactly
+    // the way the float m * (y + 0.5) + b used to.
+    int64_t fx, fdx;
+
+    // edges are kept within +-kMaxCoord in x (MUclipPoints), far inside the range of fx
+    static const int kMaxCoord = 32767;
+
     void set(float _m, float _b, int _top, int _bottom) {
         m = _m;
         b = _b;
@@ -37,7 +49,8 @@ struct my_edge {
         m = (p1.fX - p0.fX) / (p1.fY - p0.fY);
         b = p0.fX - (m * p0.fY);
 
-        curr_x = p0.fX + m * (top - p0.fY + 0.5);
+        fx = toFixed(m * (top + 0.5) + b);
+        fdx = toFixed(m);
         return true;
     }
 
@@ -49,17 +62,39 @@ struct my_edge {
         return false;
     }
 
-    int get_X(int y) {
-        return GRoundToInt(m*(y+0.5) + b);
+    // rounded x of the current row. Near a tie, x goes through float first: float rounds
+    // m * (y + 0.5) + b to the .5 it's meant to be, where the exact value is a hair off it.
+    // Further than a float ulp (at most 1/256 within kMaxCoord) from one, that can't matter.
+    int get_X() const {
+        int64_t r = fx + (INT64_C(1) << 31);
+        uint32_t past = (uint32_t) r + (1u << 24);      // how far r is past the tie, + 1/256
+        if (past >= (1u << 25)) {
+            return (int) (r >> 32);
+        }
+        return GRoundToInt((float) fx * (1.0f / 4294967296.0f));
+    }
+
+    // move to the next row
+    void step() {
+        fx += fdx;
+    }
+
+    // move from row top to row y in one go, landing where step() would have
+    void stepTo(int y) {
+        fx += fdx * (y - top);
     }
 
-    bool valid(int y) {
+    bool valid(int y) const {
         if (y > top && y < bottom) {
             return true;
         }
         return false;
     }
-    
+
+    static int64_t toFixed(double x) {
+        x = std::max(std::min(x, (double) kMaxCoord), (double) -kMaxCoord);
+        return (int64_t) floor(x * 4294967296.0 + 0.5);
+    }
 };
 
 #endif
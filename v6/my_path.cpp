@@ -46,38 +46,19 @@ GPath& GPath::addPolygon(const GPoint pts[], int count) {
 GRect GPath::bounds() const {
 
     if (countPoints() == 0) return GRect::MakeLTRB(0,0,0,0);
-    if (countPoints() == 1) return GRect::MakeXYWH(fPts.at(0).x(), fPts.at(0).y(),0,0);
-    if (countPoints() == 2) {
-        float x1 = fPts.at(0).x(); float x2 = fPts.at(1).x();
-        float y1 = fPts.at(0).y(); float y2 = fPts.at(1).y();
-        float l = std::min(x1,x2);
-        float t = std::min(y1,y2);
-        float r = std::max(x1,x2);
-        float b = std::max(y1,y2);
-        return GRect::MakeLTRB(l,t,r,b);
-    }
-    
-    float l = 999999.0;
-    float t = 999999.0;
-    float r = 0.0;
-    float b = 0.0;
 
-    for (int i = 0; i < countPoints(); i++) {
+    float l = fPts.at(0).x();
+    float t = fPts.at(0).y();
+    float r = l;
+    float b = t;
+
+    for (int i = 1; i < countPoints(); i++) {
         float x = fPts.at(i).x();
         float y = fPts.at(i).y();
-        if (x < l) {
-            l = x;
-        }
-        else if (x > r) {
-            r = x;
-        }
-
-        if (y < t) {
-            t = y;
-        }
-        else if (y > b) {
-            b = y;
-        }        
+        l = std::min(l, x);
+        r = std::max(r, x);
+        t = std::min(t, y);
+        b = std::max(b, y);
     }
 
     return GRect::MakeLTRB(l,t,r,b);
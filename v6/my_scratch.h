@@ -0,0 +1,88 @@
+#ifndef my_scratch_DEFINED
+#define my_scratch_DEFINED
+
+#include "include/GPixel.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ *  A stack of reusable, 64-byte aligned pixel rows. The canvas owns one sized to its device
+ *  width, so spans never allocate and never put a row on the stack.
+ *
+ *  Each user takes the next free slot with acquire() and hands it back with release(), so
+ *  nested users (the blitter, a composite shader, the shaders inside it, ...) each get a
+ *  slot of their own. Slots are allocated the first time a depth is reached, then reused.
+ *
+ *  Shaders don't get a scratch passed to them, so the canvas binds its scratch to the
+ *  drawing thread for the length of a draw (my_scratch::binding) and they find it with
+ *  my_scratch::get().
+ */
+class my_scratch {
+public:
+    explicit my_scratch(int width = 0) : row_width(width) {}
+
+    GPixel* acquire(int count) {
+        if (depth == (int) slots.size()) {
+            slots.push_back(slot());
+        }
+        slot& s = slots[depth++];
+        if (s.capacity < count || s.pixels == nullptr) {
+            s.allocate(std::max(count, row_width));
+        }
+        return s.pixels;
+    }
+
+    void release(int count = 1) {
+        depth -= count;
+    }
+
+    // the scratch bound to this thread, or a thread-local one if no canvas is drawing
+    static my_scratch& get() {
+        my_scratch* bound = current();
+        if (bound != nullptr) return *bound;
+        static thread_local my_scratch fallback;
+        return fallback;
+    }
+
+    // binds a scratch to the calling thread until the binding goes out of scope
+    class binding {
+    public:
+        explicit binding(my_scratch& scratch) : previous(current()) {
+            current() = &scratch;
+        }
+        ~binding() {
+            current() = previous;
+        }
+    private:
+        my_scratch* previous;
+    };
+
+private:
+    static const int kAlign = 64;
+
+    struct slot {
+        std::vector<GPixel> storage;
+        GPixel* pixels = nullptr;
+        int capacity = 0;
+
+        void allocate(int count) {
+            storage.assign(count + kAlign / sizeof(GPixel), 0);
+            uintptr_t addr = (uintptr_t) storage.data();
+            pixels = (GPixel*) ((addr + kAlign - 1) & ~(uintptr_t) (kAlign - 1));
+            capacity = count;
+        }
+    };
+
+    static my_scratch*& current() {
+        static thread_local my_scratch* bound = nullptr;
+        return bound;
+    }
+
+    int row_width;
+    int depth = 0;
+    std::vector<slot> slots;
+};
+
+#endif
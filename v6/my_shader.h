@@ -9,6 +9,7 @@
 #include "include/GPath.h"
 
 #include "my_utils.h"
+#include "my_scratch.h"
 
 #include <iostream>
 #include <vector>
@@ -18,7 +19,31 @@
 
 class my_linear_gradient;
 
-class my_shader : public GShader {
+/**
+ *  Base for our shaders. Adds an optional fused span call, for a shader that can blend
+ *  straight into the device row more cheaply than writing a temporary row that the canvas
+ *  reads back.
+ *
+ *  Our bitmap and gradient shaders keep the default: blending each pixel as it is shaded
+ *  measured up to 2x slower than shading the row and blending it with the SIMD row procs.
+ */
+class my_base_shader : public GShader {
+public:
+    /**
+     *  Shade the pixels [x, y] ... [x + count - 1, y] and blend them into dst[0...count - 1]
+     *  with the draw's blend mode, whose row proc (chosen once for the draw) is blend. The
+     *  default shades into a scratch row and blends that with blend.
+     */
+    virtual void shadeAndBlendRow(int x, int y, int count, GPixel dst[], GBlendMode, MUrowProc blend) {
+        my_scratch& scratch = my_scratch::get();
+        GPixel* row = scratch.acquire(count);
+        shadeRow(x, y, count, row);
+        blend(dst, row, count);
+        scratch.release();
+    }
+};
+
+class my_shader : public my_base_shader {
 public:
     my_shader(const GBitmap& device, const GMatrix& matrix, GShader::TileMode _tm) : fDevice(device), fMatrix(matrix), tm(_tm) {
         fInverse = GMatrix();
@@ -106,7 +131,7 @@ private:
     GShader::TileMode tm;
 };
 
-class my_linear_gradient : public GShader {
+class my_linear_gradient : public my_base_shader {
 public:
 
     my_linear_gradient(GPoint _p0, GPoint _p1, const GColor _c[], int _count, GShader::TileMode _tm) : colors_count(_count), tm(_tm) {
@@ -219,7 +244,7 @@ private:
     GShader::TileMode tm;
 };
 
-class my_tri_color_shader : public GShader {
+class my_tri_color_shader : public my_base_shader {
 public:
 
     my_tri_color_shader(const GPoint points[3], const GColor colors[3]) {
@@ -246,8 +271,10 @@ public:
         GColor dc1 = c1 - c0;
         GColor dc2 = c2 - c0;
         
+        // the color at the start of the row, then each pixel's from its own x rather than by
+        // stepping along the span, so a pixel's color doesn't depend on where its span starts
         GPoint pt; 
-        pt.set(x + 0.5, y + 0.5);
+        pt.set(0.5, y + 0.5);
         GPoint _p = fInverse * pt;
 
         GColor ddc1 = fInverse[0] * dc1;
@@ -257,8 +284,7 @@ public:
         GColor dc = ddc1 + ddc2;
 
         for (int i = 0; i < count; ++i) {
-            row[i] = MUcolorToPixel(c);
-            c += dc;
+            row[i] = MUcolorToPixel(c + (float) (x + i) * dc);
         }
 
     }
@@ -270,10 +296,12 @@ private:
     GMatrix fMatrix;
 };
 
-class my_proxy_shader : public GShader {
+class my_proxy_shader : public my_base_shader {
 public:
 
-    my_proxy_shader(GShader* shader, const GMatrix& extraTransform) : fRealShader(shader), fExtraTransform(extraTransform) {}
+    my_proxy_shader(GShader* shader, const GMatrix& extraTransform) : fRealShader(shader), fExtraTransform(extraTransform) {
+        fRealBase = dynamic_cast<my_base_shader*>(shader);
+    }
 
     bool isOpaque() override {
         return fRealShader->isOpaque();
@@ -287,12 +315,21 @@ public:
         fRealShader->shadeRow(x, y, count, row);
     }
 
+    void shadeAndBlendRow(int x, int y, int count, GPixel dst[], GBlendMode mode, MUrowProc blend) override {
+        if (fRealBase != nullptr) {
+            fRealBase->shadeAndBlendRow(x, y, count, dst, mode, blend);
+        } else {
+            my_base_shader::shadeAndBlendRow(x, y, count, dst, mode, blend);
+        }
+    }
+
 private:
     GShader* fRealShader;
+    my_base_shader* fRealBase;  // fRealShader, if it is one of ours
     GMatrix fExtraTransform;
 };
 
-class my_composite_shader : public GShader {
+class my_composite_shader : public my_base_shader {
 public:
 
     my_composite_shader(GShader* shader0, GShader* shader1) : s0(shader0), s1(shader1) {}
@@ -306,12 +343,16 @@ public:
     }
 
     void shadeRow(int x, int y, int count, GPixel row[]) override {
-        GPixel c0[count], c1[count];
+        // nested shaders take the slots after ours
+        my_scratch& scratch = my_scratch::get();
+        GPixel* c0 = scratch.acquire(count);
+        GPixel* c1 = scratch.acquire(count);
         s0->shadeRow(x, y, count, c0);
         s1->shadeRow(x, y, count, c1);
         for (int i = 0; i < count; i++) {
             row[i] = MUmultiplyPixels(c0[i], c1[i]);
         }
+        scratch.release(2);
     }
 
 private:
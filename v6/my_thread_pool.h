@@ -0,0 +1,122 @@
+#ifndef my_thread_pool_DEFINED
+#define my_thread_pool_DEFINED
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ *  A fixed set of worker threads for splitting one draw into independent pieces (bands of
+ *  rows, tiles, ...). parallel_for() hands out indices [0, count) to the workers and the
+ *  calling thread, and returns once every index has run.
+ *
+ *  Only one parallel_for runs at a time. A call made while another is in flight (including
+ *  one made from inside fn) just runs serially on the calling thread, so nesting is safe.
+ */
+class my_thread_pool {
+public:
+    explicit my_thread_pool(int workers) {
+        for (int i = 0; i < workers; ++i) {
+            threads.emplace_back([this] { work(); });
+        }
+    }
+
+    ~my_thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
+
+    // number of threads that can run a parallel_for at once, including the caller
+    int size() const {
+        return (int) threads.size() + 1;
+    }
+
+    void parallel_for(int count, const std::function<void(int)>& fn) {
+        bool idle = false;
+        if (threads.empty() || count <= 1 || !running.compare_exchange_strong(idle, true)) {
+            for (int i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            job_count = count;
+            next.store(0);
+            pending = (int) threads.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        run(fn, count);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return pending == 0; });
+            job = nullptr;
+        }
+        running.store(false);
+    }
+
+    // shared pool sized to the machine, created on first use
+    static my_thread_pool& shared() {
+        static my_thread_pool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+private:
+    void run(const std::function<void(int)>& fn, int count) {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            fn(i);
+        }
+    }
+
+    void work() {
+        int seen = 0;
+        for (;;) {
+            const std::function<void(int)>* fn;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+                fn = job;
+                count = job_count;
+            }
+
+            run(*fn, count);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::atomic<bool> running{false};   // set for the duration of a parallel_for
+    std::mutex mutex;                   // guards the job fields below
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    int job_count = 0;
+    int pending = 0;
+    int generation = 0;
+    bool quit = false;
+    std::atomic<int> next{0};
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef my_tiles_DEFINED
+#define my_tiles_DEFINED
+
+#include "include/GColor.h"
+#include "include/GMatrix.h"
+#include "include/GPaint.h"
+#include "include/GPoint.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "my_utils.h"
+#include "my_edge.h"
+#include "my_aa.h"
+
+/**
+ *  The geometry of one fill, built once in device space for the canvas's AA mode. It can then
+ *  be filled into any clip (the whole device, or one tile at a time) with the same pixels.
+ */
+struct my_shape {
+    my_aa_mode mode;
+    int shift;                      // MUsupersampleShift(mode)
+    bool convex;                    // at most two edges are active on any row
+    my_irect bounds;                // the device pixels it can touch
+    std::vector<my_edge> edges;     // sorted (MUsortEdges), scaled by 1 << shift; unless kAnalytic
+    my_aa_lines lines;              // kAnalytic only
+};
+
+// the arrays of a drawMesh call, copied so it can be replayed later
+struct my_mesh {
+    std::vector<GPoint> verts;
+    std::vector<GColor> colors;     // empty if the mesh had none
+    std::vector<GPoint> texs;       // empty if the mesh had none
+    std::vector<int> indices;
+    int count;
+};
+
+// a draw made in tiled mode, waiting for my_canvas::flush()
+struct my_tiled_draw {
+    enum kind_t {
+        kPaint,     // drawPaint: every pixel
+        kRect,      // axis-aligned drawRect: exactly the pixels of bounds
+        kShape,     // a filled my_shape
+        kMesh,      // drawMesh, replayed per tile
+    };
+
+    kind_t kind;
+    GPaint paint;
+    GMatrix ctm;
+    my_irect bounds;                // the device pixels it can touch
+    int index;                      // kShape / kMesh: which recorded shape / mesh
+    int lock;                       // which shader lock to hold drawing it, -1 for none
+};
+
+/**
+ *  Splits the device into square tiles (kTileSize unless reset() says otherwise) and keeps,
+ *  for each tile, the draws (by index, in drawing order) whose bounds overlap it.
+ */
+class my_tile_bins {
+public:
+    static const int kTileSize = 64;
+
+    void reset(int width, int height, int tile_size = kTileSize) {
+        w = width;
+        h = height;
+        size = tile_size;
+        cols = (w + size - 1) / size;
+        rows = (h + size - 1) / size;
+        bins.resize(cols * rows);
+        clear();
+    }
+
+    void clear() {
+        for (std::vector<int>& bin : bins) {
+            bin.clear();
+        }
+    }
+
+    // add draw to every tile that bounds (inside the device) overlaps
+    void add(int draw, const my_irect& bounds) {
+        if (bounds.isEmpty()) return;
+
+        int c1 = (bounds.fRight - 1) / size;
+        int r1 = (bounds.fBottom - 1) / size;
+        for (int r = bounds.fTop / size; r <= r1; ++r) {
+            for (int c = bounds.fLeft / size; c <= c1; ++c) {
+                bins[r * cols + c].push_back(draw);
+            }
+        }
+    }
+
+    int count() const {
+        return cols * rows;
+    }
+
+    // the pixels of tile i, row by row from the top left
+    my_irect tile(int i) const {
+        int x = (i % cols) * size;
+        int y = (i / cols) * size;
+        return { x, y, std::min(x + size, w), std::min(y + size, h) };
+    }
+
+    const std::vector<int>& bin(int i) const {
+        return bins[i];
+    }
+
+private:
+    int w = 0, h = 0;
+    int size = kTileSize;
+    int cols = 0, rows = 0;
+    std::vector<std::vector<int>> bins;
+};
+
+#endif
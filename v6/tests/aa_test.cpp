@@ -0,0 +1,169 @@
+/**
+ *  Anti-aliased coverage: analytic coverage of rects against their exact overlap with each
+ *  pixel, MUaccumulateCoverage against a plain running sum, my_coverage_mask handing rows on
+ *  as written, and shapes reaching far outside the device still covering all of it in every
+ *  mode.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <random>
+
+// the area of [l, r) x [t, b) inside pixel (x, y), as 0...255
+static int overlap(float l, float t, float r, float b, int x, int y) {
+    float w = std::max(0.f, std::min(r, x + 1.f) - std::max(l, (float) x));
+    float h = std::max(0.f, std::min(b, y + 1.f) - std::max(t, (float) y));
+    return (int) (w * h * 255 + 0.5f);
+}
+
+static void test_rect_coverage(std::mt19937& rng) {
+    const int kW = 40, kH = 30;
+    my_aa_lines shape;
+    my_coverage_rasterizer rasterizer;
+    my_coverage_mask rows;
+    std::vector<int> got(kW * kH);
+
+    for (int t = 0; t < 500; ++t) {
+        float l = (rng() % 5000) / 100.f - 5, r = (rng() % 5000) / 100.f - 5;
+        float top = (rng() % 4000) / 100.f - 5, b = (rng() % 4000) / 100.f - 5;
+        if (l > r) std::swap(l, r);
+        if (top > b) std::swap(top, b);
+
+        GPoint pts[4] = { { l, top }, { r, top }, { r, b }, { l, b } };
+        shape.reset(kW, kH);
+        for (int i = 0; i < 4; ++i) {
+            shape.addLine(pts[i], pts[(i + 1) % 4]);
+        }
+        shape.finish();
+
+        std::fill(got.begin(), got.end(), 0);
+        rows.reset(kW, 0, kW);
+        rasterizer.rasterize(shape, 0, kH, kW, rows, [&](const uint8_t mask[], size_t rowBytes, int x, int y, int w, int h) {
+            for (int j = 0; j < h; ++j) {
+                for (int i = 0; i < w; ++i) {
+                    got[(y + j) * kW + x + i] = mask[j * rowBytes + i];
+                }
+            }
+        });
+
+        for (int y = 0; y < kH; ++y) {
+            for (int x = 0; x < kW; ++x) {
+                int expected = overlap(l, top, r, b, x, y);
+                int c = got[y * kW + x];
+                MU_CHECK(std::abs(c - expected) <= 1, "rect %g %g %g %g pixel %d %d: coverage %d, expected %d",
+                         l, top, r, b, x, y, c, expected);
+            }
+        }
+    }
+}
+
+static void test_accumulate(std::mt19937& rng) {
+    const int kMax = 37;
+    float acc[kMax];
+    uint8_t got[kMax];
+
+    for (int t = 0; t < 2000; ++t) {
+        // multiples of 1/64 add up exactly in any order, so those must match bit for bit
+        bool exact = t % 2 == 0;
+        int count = rng() % (kMax + 1);
+        for (int i = 0; i < count; ++i) {
+            acc[i] = exact ? ((int) (rng() % 257) - 128) / 64.f : ((int) (rng() % 20001) - 10000) / 10000.f;
+        }
+        MUaccumulateCoverage(acc, got, count);
+
+        float sum = 0;
+        for (int i = 0; i < count; ++i) {
+            sum += acc[i];
+            int expected = (int) (std::min(fabsf(sum), 1.f) * 255 + 0.5f);
+            MU_CHECK(exact ? got[i] == expected : std::abs(got[i] - expected) <= 1,
+                     "count %d pixel %d: coverage %d, expected %d", count, i, got[i], expected);
+        }
+    }
+}
+
+// rows written into my_coverage_mask reach blit as they were written, clipped, in masks that
+// are 0 everywhere else
+static void test_coverage_mask(std::mt19937& rng) {
+    const int kW = 53, kH = 70;
+    my_coverage_mask rows;
+    std::vector<int> got(kW * kH), expected(kW * kH);
+
+    for (int t = 0; t < 200; ++t) {
+        std::fill(got.begin(), got.end(), 0);
+        std::fill(expected.begin(), expected.end(), 0);
+        auto blit = [&](const uint8_t mask[], size_t rowBytes, int x, int y, int w, int h) {
+            for (int j = 0; j < h; ++j) {
+                for (int i = 0; i < w; ++i) {
+                    MU_CHECK(got[(y + j) * kW + x + i] == 0, "pixel %d %d handed over twice", x + i, y + j);
+                    got[(y + j) * kW + x + i] = mask[j * rowBytes + i];
+                }
+            }
+        };
+
+        int left = rng() % 10, right = kW - rng() % 10;
+        rows.reset(kW, left, right);
+        for (int y = rng() % 5; y < kH; y += rng() % 8 == 0 ? 2 + rng() % 3 : 1) {
+            int x = rng() % kW;
+            int count = 1 + rng() % (kW - x);
+            uint8_t* row = rows.row(y, blit);
+            for (int i = x; i < x + count; ++i) {
+                row[i] = 1 + rng() % 255;
+                if (i >= left && i < right) expected[y * kW + i] = row[i];
+            }
+            rows.commit(x, x + count);
+        }
+        rows.flush(blit);
+
+        int differ = 0;
+        for (int i = 0; i < kW * kH; ++i) {
+            differ += got[i] != expected[i];
+        }
+        MU_CHECK(differ == 0, "case %d: %d pixels differ", t, differ);
+    }
+}
+
+// a rect whose sides lie anywhere from just outside the device to 1e10 past it, under a
+// random scale and translate, must reach every pixel
+static void test_huge_rects(std::mt19937& rng) {
+    const my_aa_mode modes[] = { my_aa_mode::kNone, my_aa_mode::kAnalytic,
+                                 my_aa_mode::kSupersample4, my_aa_mode::kSupersample16 };
+    auto big = [&]() { return powf(10, 6 + rng() % 5) * (1 + (rng() % 100) / 100.f); };
+
+    for (int t = 0; t < 2000; ++t) {
+        my_aa_mode mode = modes[t % 4];
+        int w = 50 + rng() % 200, h = 50 + rng() % 200;
+        my_test_device device(w, h, GPixel_PackARGB(255, 255, 0, 0));
+        my_canvas canvas(device.bitmap());
+        canvas.setAntiAlias(mode);
+
+        float sx = (rng() % 1000 + 1) / 2000.f, sy = (rng() % 1000 + 1) / 2000.f;
+        float tx = (rng() % 1000) / 3.f - 150, ty = (rng() % 1000) / 7.f - 70;
+        canvas.translate(tx, ty);
+        canvas.scale(sx, sy);
+
+        // device bounds, mapped back through the CTM
+        float l = rng() % 2 ? -big() : -1.f - rng() % 5;
+        float top = rng() % 2 ? -big() : -1.f - rng() % 5;
+        float r = rng() % 2 ? big() : w + 1.f + rng() % 5;
+        float b = rng() % 2 ? big() : h + 1.f + rng() % 5;
+        GRect rect = GRect::MakeLTRB((l - tx) / sx, (top - ty) / sy, (r - tx) / sx, (b - ty) / sy);
+        canvas.drawRect(rect, GPaint().setBlendMode(GBlendMode::kClear));
+
+        int left = 0;
+        for (GPixel p : device.pixels) {
+            left += p != 0;
+        }
+        MU_CHECK(left == 0, "aa mode %d, %dx%d, rect %g %g %g %g in device space: %d pixels not cleared",
+                 (int) mode, w, h, l, top, r, b, left);
+    }
+}
+
+int main() {
+    std::mt19937 rng(1);
+    test_rect_coverage(rng);
+    test_accumulate(rng);
+    test_coverage_mask(rng);
+    test_huge_rects(rng);
+    return MUtestResult("aa_test");
+}
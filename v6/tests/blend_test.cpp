@@ -0,0 +1,160 @@
+/**
+ *  The blend row procs against MUblend, pixel by pixel, the SIMD row kernels against the
+ *  scalar procs, and MUreduceBlendMode's table against the modes it replaces.
+ */
+
+#include "my_utils.h"
+#include "my_simd.h"
+#include "tests/my_test.h"
+
+#include <random>
+
+static const GBlendMode kModes[] = {
+    GBlendMode::kClear, GBlendMode::kSrc, GBlendMode::kDst, GBlendMode::kSrcOver,
+    GBlendMode::kDstOver, GBlendMode::kSrcIn, GBlendMode::kDstIn, GBlendMode::kSrcOut,
+    GBlendMode::kDstOut, GBlendMode::kSrcATop, GBlendMode::kDstATop, GBlendMode::kXor,
+};
+
+// a premultiplied pixel, often with alpha 0 or 255
+static GPixel random_pixel(std::mt19937& rng) {
+    unsigned a;
+    switch (rng() % 4) {
+        case 0: a = 0; break;
+        case 1: a = 255; break;
+        default: a = rng() % 256; break;
+    }
+    return GPixel_PackARGB(a, rng() % (a + 1), rng() % (a + 1), rng() % (a + 1));
+}
+
+static void test_row_procs(std::mt19937& rng) {
+    const int kCount = 67;
+    GPixel src[kCount], dst[kCount], expected[kCount];
+
+    for (GBlendMode mode : kModes) {
+        my_blend_procs procs = MUchooseBlendProcs(mode);
+        for (int t = 0; t < 100; ++t) {
+            for (int i = 0; i < kCount; ++i) {
+                src[i] = random_pixel(rng);
+                dst[i] = random_pixel(rng);
+                expected[i] = MUblend(src[i], dst[i], mode);
+            }
+            procs.row(dst, src, kCount);
+            for (int i = 0; i < kCount; ++i) {
+                MU_CHECK(dst[i] == expected[i], "mode %d row pixel %d: %08x, expected %08x", (int) mode, i, dst[i], expected[i]);
+            }
+
+            GPixel color = random_pixel(rng);
+            for (int i = 0; i < kCount; ++i) {
+                dst[i] = random_pixel(rng);
+                expected[i] = MUblend(color, dst[i], mode);
+            }
+            procs.color(dst, color, kCount);
+            for (int i = 0; i < kCount; ++i) {
+                MU_CHECK(dst[i] == expected[i], "mode %d color pixel %d: %08x, expected %08x", (int) mode, i, dst[i], expected[i]);
+            }
+        }
+        if (procs.copiesSrc) {
+            MU_CHECK(mode == GBlendMode::kSrc, "mode %d claims to copy src", (int) mode);
+        }
+    }
+}
+
+// the reduced mode must give every pixel the full mode would, for sources of its kind
+static void test_reduce(std::mt19937& rng) {
+    for (GBlendMode mode : kModes) {
+        for (int kind = 0; kind < 3; ++kind) {
+            bool opaque = kind == 1;
+            bool transparent = kind == 2;
+            GBlendMode reduced = MUreduceBlendMode(mode, opaque, transparent);
+            if (kind == 0) {
+                MU_CHECK(reduced == mode, "mode %d reduced without knowing the source", (int) mode);
+            }
+
+            for (int t = 0; t < 2000; ++t) {
+                GPixel src = random_pixel(rng);
+                if (opaque) src |= GPixel_PackARGB(255, 0, 0, 0);
+                if (transparent) src = 0;
+                GPixel dst = random_pixel(rng);
+                GPixel expected = MUblend(src, dst, mode);
+                GPixel got = MUblend(src, dst, reduced);
+                MU_CHECK(got == expected, "mode %d %s source, reduced to %d: src %08x dst %08x gives %08x, expected %08x",
+                         (int) mode, opaque ? "opaque" : transparent ? "transparent" : "any", (int) reduced, src, dst, got, expected);
+            }
+        }
+    }
+}
+
+#if MU_SIMD_X86
+
+// run a kernel pair (row, color) and the scalar procs over the same rows, every length up to
+// a few vectors and every start offset within one, and compare
+template <GBlendMode mode, GPixel (*blend)(GPixel, GPixel)>
+static void check_kernels(std::mt19937& rng, const char* name, MUrowProc row, MUcolorProc color) {
+    const int kMax = 40, kPad = 8;
+    GPixel src[kMax + kPad], dst[kMax + kPad], expected[kMax + kPad];
+
+    for (int offset = 0; offset < kPad; ++offset) {
+        for (int count = 0; count <= kMax; ++count) {
+            for (int i = 0; i < kMax + kPad; ++i) {
+                src[i] = random_pixel(rng);
+                dst[i] = expected[i] = random_pixel(rng);
+            }
+            MUblendRow<blend>(expected + offset, src + offset, count);
+            row(dst + offset, src + offset, count);
+            for (int i = 0; i < kMax + kPad; ++i) {
+                MU_CHECK(dst[i] == expected[i], "%s mode %d row: offset %d count %d pixel %d: %08x, expected %08x",
+                         name, (int) mode, offset, count, i, dst[i], expected[i]);
+            }
+
+            GPixel c = random_pixel(rng);
+            for (int i = 0; i < kMax + kPad; ++i) {
+                dst[i] = expected[i] = random_pixel(rng);
+            }
+            MUblendColor<blend>(expected + offset, c, count);
+            color(dst + offset, c, count);
+            for (int i = 0; i < kMax + kPad; ++i) {
+                MU_CHECK(dst[i] == expected[i], "%s mode %d color: offset %d count %d pixel %d: %08x, expected %08x",
+                         name, (int) mode, offset, count, i, dst[i], expected[i]);
+            }
+        }
+    }
+}
+
+template <GBlendMode mode, GPixel (*blend)(GPixel, GPixel)>
+static void test_kernels(std::mt19937& rng) {
+    check_kernels<mode, blend>(rng, "sse2", MUblendRow_sse2<mode, blend>, MUblendColor_sse2<mode, blend>);
+    if (MUhasAVX2()) {
+        check_kernels<mode, blend>(rng, "avx2", MUblendRow_avx2<mode, blend>, MUblendColor_avx2<mode, blend>);
+    }
+}
+
+static void test_simd(std::mt19937& rng) {
+    test_kernels<GBlendMode::kSrcOver, MUsrcOver>(rng);
+    test_kernels<GBlendMode::kDstOver, MUdstOver>(rng);
+    test_kernels<GBlendMode::kSrcIn, MUsrcIn>(rng);
+    test_kernels<GBlendMode::kDstIn, MUdstIn>(rng);
+    test_kernels<GBlendMode::kSrcOut, MUsrcOut>(rng);
+    test_kernels<GBlendMode::kDstOut, MUdstOut>(rng);
+    test_kernels<GBlendMode::kSrcATop, MUsrcATop>(rng);
+    test_kernels<GBlendMode::kDstATop, MUdstATop>(rng);
+    test_kernels<GBlendMode::kXor, MUxor>(rng);
+
+    // and what MUchooseSimdBlendProcs hands out keeps copiesSrc
+    for (GBlendMode mode : kModes) {
+        MU_CHECK(MUchooseSimdBlendProcs(mode).copiesSrc == MUchooseBlendProcs(mode).copiesSrc, "mode %d", (int) mode);
+    }
+}
+
+#else
+
+static void test_simd(std::mt19937&) {}
+
+#endif
+
+int main() {
+    std::mt19937 rng(1);
+    test_row_procs(rng);
+    test_simd(rng);
+    test_reduce(rng);
+    return MUtestResult("blend_test");
+}
@@ -0,0 +1,120 @@
+/**
+ *  Every blitter's blitAntiH and blitMask against what they stand for, pixel by pixel: the
+ *  source blended with the device by MUblend, then lerped in by coverage.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <random>
+
+static const GBlendMode kModes[] = {
+    GBlendMode::kClear, GBlendMode::kSrc, GBlendMode::kDst, GBlendMode::kSrcOver,
+    GBlendMode::kDstOver, GBlendMode::kSrcIn, GBlendMode::kDstIn, GBlendMode::kSrcOut,
+    GBlendMode::kDstOut, GBlendMode::kSrcATop, GBlendMode::kDstATop, GBlendMode::kXor,
+};
+
+static GPixel random_pixel(std::mt19937& rng) {
+    unsigned a = rng() % 3 == 0 ? 255 : rng() % 256;
+    return GPixel_PackARGB(a, rng() % (a + 1), rng() % (a + 1), rng() % (a + 1));
+}
+
+// coverage in runs of 0, of 255 and of partial values, as the rasterizers make it
+static void random_coverage(std::mt19937& rng, uint8_t coverage[], int count) {
+    for (int i = 0; i < count;) {
+        int n = std::min(count - i, 1 + (int) (rng() % 9));
+        int kind = rng() % 3;
+        for (int k = 0; k < n; ++k) {
+            coverage[i + k] = kind == 0 ? 0 : kind == 1 ? 255 : 1 + rng() % 254;
+        }
+        i += n;
+    }
+}
+
+int main() {
+    std::mt19937 rng(1);
+    const int kW = 97, kH = 23;
+    my_test_device device(kW, kH), expected(kW, kH);
+    GBitmap bitmap = device.bitmap();
+
+    std::vector<GPixel> opaque_pixels(16 * 16), pixels(16 * 16);
+    for (int i = 0; i < 16 * 16; ++i) {
+        opaque_pixels[i] = random_pixel(rng) | GPixel_PackARGB(255, 0, 0, 0);
+        pixels[i] = random_pixel(rng);
+    }
+    auto opaque_shader = GCreateBitmapShader(GBitmap(16, 16, 16 * sizeof(GPixel), opaque_pixels.data(), true),
+                                             GMatrix::Scale(3, 2), GShader::TileMode::kRepeat);
+    auto shader = GCreateBitmapShader(GBitmap(16, 16, 16 * sizeof(GPixel), pixels.data(), false),
+                                      GMatrix::Scale(2, 3), GShader::TileMode::kMirror);
+    opaque_shader->setContext(GMatrix());
+    shader->setContext(GMatrix());
+
+    my_solid_blitter solid(bitmap);
+    my_solid_copy_blitter solid_copy(bitmap);
+    my_shader_blitter shaded(bitmap);
+    my_shader_copy_blitter shaded_copy(bitmap);
+
+    my_scratch scratch(kW);
+    my_scratch::binding bind(scratch);
+    std::vector<uint8_t> mask(kW * kH);
+    GPixel src_row[kW];
+
+    for (int t = 0; t < 3000; ++t) {
+        GBlendMode mode = kModes[rng() % 12];
+        bool use_shader = rng() % 2;
+        bool copy = rng() % 3 == 0;
+        if (copy) mode = GBlendMode::kSrc;
+
+        my_draw_context ctx;
+        ctx.mode = mode;
+        ctx.procs = MUchooseSimdBlendProcs(mode);
+        ctx.src = random_pixel(rng);
+        ctx.shader = nullptr;
+        ctx.fused = nullptr;
+        ctx.opaque = false;
+        my_blitter* blitter = copy ? (my_blitter*) &solid_copy : &solid;
+        if (use_shader) {
+            ctx.shader = copy ? opaque_shader.get() : shader.get();
+            ctx.fused = dynamic_cast<my_base_shader*>(ctx.shader);
+            ctx.opaque = copy;
+            blitter = copy ? (my_blitter*) &shaded_copy : &shaded;
+        }
+        blitter->setContext(ctx);
+
+        for (GPixel& p : device.pixels) {
+            p = random_pixel(rng);
+        }
+        expected.pixels = device.pixels;
+
+        int x = rng() % kW, y = rng() % kH;
+        int w = 1 + rng() % (kW - x), h = 1 + rng() % (kH - y);
+        bool as_mask = rng() % 2;
+        if (!as_mask) h = 1;
+        size_t rowBytes = kW;
+        for (int j = 0; j < h; ++j) {
+            random_coverage(rng, mask.data() + j * rowBytes, w);
+        }
+
+        for (int j = 0; j < h; ++j) {
+            if (ctx.shader != nullptr) {
+                ctx.shader->shadeRow(x, y + j, w, src_row);
+            }
+            for (int i = 0; i < w; ++i) {
+                GPixel& d = expected.pixels[(y + j) * kW + x + i];
+                GPixel blended = MUblend(ctx.shader != nullptr ? src_row[i] : ctx.src, d, mode);
+                d = MUlerpPixel(d, blended, mask[j * rowBytes + i]);
+            }
+        }
+
+        if (as_mask) {
+            blitter->blitMask(mask.data(), rowBytes, x, y, w, h);
+        } else {
+            blitter->blitAntiH(x, y, w, mask.data());
+        }
+
+        int differ = device.diff(expected);
+        MU_CHECK(differ == 0, "%s%s mode %d, %s %d %d %dx%d: %d pixels differ", use_shader ? "shader" : "solid",
+                 copy ? " copy" : "", (int) mode, as_mask ? "blitMask" : "blitAntiH", x, y, w, h, differ);
+    }
+    return MUtestResult("blitter_test");
+}
@@ -0,0 +1,111 @@
+/**
+ *  Culled playback against full playback: the commands cullOccluded() hides must not change
+ *  a pixel, in any AA mode, under any playback CTM.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <random>
+
+static float unit(std::mt19937& rng) {
+    return (rng() % 1001) / 1000.f;
+}
+
+static GPaint paint(std::mt19937& rng) {
+    const GBlendMode modes[] = { GBlendMode::kSrcOver, GBlendMode::kSrcOver, GBlendMode::kSrc,
+                                 GBlendMode::kDstIn, GBlendMode::kClear, GBlendMode::kXor };
+    float a = rng() % 3 == 0 ? 1 : rng() % 4 == 0 ? 0 : unit(rng);
+    return GPaint({ unit(rng), unit(rng), unit(rng), a }).setBlendMode(modes[rng() % 6]);
+}
+
+// a random scene, with many rects that can hide what's under them, some reaching far off the
+// device
+static void record_scene(GCanvas* canvas, uint32_t seed) {
+    std::mt19937 rng(seed);
+    auto coord = [&](float size) {
+        switch (rng() % 8) {
+            case 0: return -2e9f * (1 + unit(rng));
+            case 1: return 2e9f * (1 + unit(rng));
+            default: return (size + 40) * unit(rng) - 20;
+        }
+    };
+
+    canvas->drawPaint(GPaint({ 1, 1, 1, 1 }));
+    for (int i = 0; i < 30; ++i) {
+        canvas->save();
+        if (rng() % 3 == 0) {
+            canvas->translate(unit(rng) * 20, unit(rng) * 20);
+            canvas->scale(0.5f + unit(rng), 0.5f + unit(rng));
+        }
+        switch (rng() % 4) {
+            case 0:
+            case 1: {
+                float x0 = coord(200), x1 = coord(200), y0 = coord(150), y1 = coord(150);
+                canvas->drawRect(GRect::MakeLTRB(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1)), paint(rng));
+                break;
+            }
+            case 2: {
+                GPoint pts[5];
+                for (GPoint& p : pts) {
+                    p = { 240 * unit(rng) - 20, 190 * unit(rng) - 20 };
+                }
+                canvas->drawConvexPolygon(pts, 3, paint(rng));
+                break;
+            }
+            case 3: {
+                GPath path;
+                path.moveTo({ 240 * unit(rng) - 20, 190 * unit(rng) - 20 });
+                for (int k = 0; k < 4; ++k) {
+                    path.lineTo({ 240 * unit(rng) - 20, 190 * unit(rng) - 20 });
+                }
+                canvas->drawPath(path, paint(rng));
+                break;
+            }
+        }
+        canvas->restore();
+    }
+}
+
+int main() {
+    const my_aa_mode modes[] = { my_aa_mode::kNone, my_aa_mode::kAnalytic,
+                                 my_aa_mode::kSupersample4, my_aa_mode::kSupersample16 };
+    int hidden_total = 0;
+
+    for (uint32_t seed = 1; seed <= 60; ++seed) {
+        my_display_list list;
+        my_recording_canvas recorder(&list);
+        record_scene(&recorder, seed);
+
+        std::mt19937 rng(seed);
+        GMatrix ctm;
+        if (seed % 3 != 0) {
+            ctm = GMatrix::Translate(10 * unit(rng) - 5, 10 * unit(rng) - 5) *
+                  GMatrix::Scale(0.25f + 2 * unit(rng), 0.25f + 2 * unit(rng));
+        }
+        std::vector<bool> hidden;
+        hidden_total += list.cullOccluded(ctm, &hidden);
+
+        for (my_aa_mode mode : modes) {
+            my_test_device all(203, 151), culled(203, 151);
+            {
+                my_canvas canvas(all.bitmap());
+                canvas.setAntiAlias(mode);
+                canvas.concat(ctm);
+                list.playback(&canvas);
+            }
+            {
+                my_canvas canvas(culled.bitmap());
+                canvas.setAntiAlias(mode);
+                canvas.concat(ctm);
+                list.playback(&canvas, hidden);
+            }
+            int differ = all.diff(culled);
+            MU_CHECK(differ == 0, "aa mode %d seed %u: %d pixels differ culled", (int) mode, seed, differ);
+        }
+    }
+
+    // and the scenes do cull something, or there'd be nothing to check
+    MU_CHECK(hidden_total > 100, "only %d commands hidden", hidden_total);
+    return MUtestResult("cull_test");
+}
@@ -0,0 +1,196 @@
+/**
+ *  Display lists against immediate draws: drawDisplayList, on one thread or several, whole or
+ *  over an area, must give the pixels drawing the scene straight into the canvas does, in
+ *  every AA mode; and a recorder must not keep using its CTM across a reset() of its list.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <memory>
+#include <random>
+
+static float unit(std::mt19937& rng) {
+    return (rng() % 1001) / 1000.f;
+}
+
+static GColor color(std::mt19937& rng) {
+    return { unit(rng), unit(rng), unit(rng), rng() % 3 == 0 ? 1 : unit(rng) };
+}
+
+static GPaint paint(std::mt19937& rng, GShader* shader) {
+    const GBlendMode modes[] = { GBlendMode::kSrcOver, GBlendMode::kSrcOver, GBlendMode::kSrc,
+                                 GBlendMode::kDstIn, GBlendMode::kClear, GBlendMode::kXor };
+    GPaint p = GPaint(color(rng)).setBlendMode(modes[rng() % 6]);
+    if (rng() % 4 == 0) {
+        p.setShader(shader);
+    }
+    return p;
+}
+
+static GPoint point(std::mt19937& rng) {
+    return { 640 * unit(rng) - 20, 480 * unit(rng) - 20 };
+}
+
+static void draw_scene(GCanvas* canvas, uint32_t seed, GShader* shader) {
+    std::mt19937 rng(seed);
+    canvas->drawPaint(GPaint({ 1, 1, 1, 1 }));
+    for (int i = 0; i < 40; ++i) {
+        canvas->save();
+        if (rng() % 3 == 0) {
+            canvas->translate(unit(rng) * 20, unit(rng) * 20);
+            canvas->scale(0.5f + unit(rng), 0.5f + unit(rng));
+        }
+        switch (rng() % 5) {
+            case 0: {
+                GPoint p0 = point(rng), p1 = point(rng);
+                canvas->drawRect(GRect::MakeLTRB(std::min(p0.fX, p1.fX), std::min(p0.fY, p1.fY),
+                                                 std::max(p0.fX, p1.fX), std::max(p0.fY, p1.fY)), paint(rng, shader));
+                break;
+            }
+            case 1: {
+                GPoint pts[4] = { point(rng), point(rng), point(rng), point(rng) };
+                canvas->drawConvexPolygon(pts, 3 + rng() % 2, paint(rng, shader));
+                break;
+            }
+            case 2: {
+                GPath path;
+                path.addCircle(point(rng), 5 + 150 * unit(rng));
+                canvas->drawPath(path, paint(rng, shader));
+                break;
+            }
+            case 3: {
+                GPath path;
+                path.moveTo(point(rng));
+                for (int k = 0; k < 5; ++k) {
+                    path.lineTo(point(rng));
+                }
+                canvas->drawPath(path, paint(rng, shader));
+                break;
+            }
+            case 4: {
+                GPoint verts[4] = { point(rng), point(rng), point(rng), point(rng) };
+                GColor colors[4] = { color(rng), color(rng), color(rng), color(rng) };
+                GPoint texs[4] = { { 0, 0 }, { 48, 0 }, { 48, 48 }, { 0, 48 } };
+                bool textured = rng() % 2;
+                canvas->drawQuad(verts, colors, textured ? texs : nullptr, rng() % 3,
+                                 textured ? GPaint(shader) : GPaint());
+                break;
+            }
+        }
+        canvas->restore();
+    }
+}
+
+static void test_playback(GShader* shader) {
+    const my_aa_mode modes[] = { my_aa_mode::kNone, my_aa_mode::kAnalytic,
+                                 my_aa_mode::kSupersample4, my_aa_mode::kSupersample16 };
+    const int kW = 601, kH = 457;
+    const GPixel kUntouched = GPixel_PackARGB(255, 0, 255, 0);
+    my_thread_pool pool(3);
+
+    for (my_aa_mode mode : modes) {
+        for (uint32_t seed = 1; seed <= 6; ++seed) {
+            std::mt19937 rng(seed);
+            GMatrix ctm = GMatrix::Translate(20 * unit(rng) - 10, 20 * unit(rng) - 10) *
+                          GMatrix::Scale(0.75f + unit(rng) / 2, 0.75f + unit(rng) / 2);
+
+            my_test_device immediate(kW, kH);
+            {
+                my_canvas canvas(immediate.bitmap());
+                canvas.setAntiAlias(mode);
+                canvas.concat(ctm);
+                draw_scene(&canvas, seed, shader);
+            }
+
+            my_display_list list;
+            my_recording_canvas recorder(&list);
+            draw_scene(&recorder, seed, shader);
+
+            for (int threads : { 1, 4 }) {
+                my_test_device played(kW, kH);
+                {
+                    my_canvas canvas(played.bitmap());
+                    canvas.setAntiAlias(mode);
+                    canvas.setThreadPool(&pool);
+                    canvas.setThreadCount(threads);
+                    canvas.concat(ctm);
+                    canvas.drawDisplayList(list);
+                }
+                int differ = immediate.diff(played);
+                MU_CHECK(differ == 0, "aa mode %d seed %u, %d threads: %d pixels differ in playback",
+                         (int) mode, seed, threads, differ);
+
+                // over an area: its pixels as drawn, the others left alone
+                GRect area = GRect::MakeLTRB(kW * unit(rng) - 50, kH * unit(rng) - 50, 0, 0);
+                area.fRight = area.fLeft + 50 + 300 * unit(rng);
+                area.fBottom = area.fTop + 50 + 300 * unit(rng);
+                my_test_device partial(kW, kH, kUntouched);
+                {
+                    my_canvas canvas(partial.bitmap());
+                    canvas.setAntiAlias(mode);
+                    canvas.setThreadPool(&pool);
+                    canvas.setThreadCount(threads);
+                    canvas.concat(ctm);
+                    canvas.drawDisplayList(list, area);
+                }
+                differ = 0;
+                for (int y = 0; y < kH; ++y) {
+                    for (int x = 0; x < kW; ++x) {
+                        bool inside = x >= floorf(area.fLeft) && x < ceilf(area.fRight) &&
+                                      y >= floorf(area.fTop) && y < ceilf(area.fBottom);
+                        differ += partial.pixels[y * kW + x] != (inside ? immediate.pixels[y * kW + x] : kUntouched);
+                    }
+                }
+                MU_CHECK(differ == 0, "aa mode %d seed %u, %d threads, area %g %g %g %g: %d pixels differ",
+                         (int) mode, seed, threads, area.fLeft, area.fTop, area.fRight, area.fBottom, differ);
+            }
+        }
+    }
+}
+
+// a recorder that drew under a CTM before its list was reset records that CTM again after
+static void test_reset() {
+    my_display_list list;
+    my_recording_canvas recorder(&list), other(&list);
+    recorder.translate(40, 30);
+    recorder.drawRect(GRect::MakeLTRB(0, 0, 10, 10), GPaint());
+    list.reset();
+
+    // other's matrix takes the slot recorder's stale index points at
+    other.scale(3, 3);
+    other.drawRect(GRect::MakeLTRB(0, 0, 1, 1), GPaint({ 0, 0, 1, 1 }));
+    recorder.drawRect(GRect::MakeLTRB(0, 0, 10, 10), GPaint({ 1, 0, 0, 1 }));
+
+    my_test_device played(64, 64), expected(64, 64);
+    {
+        my_canvas canvas(played.bitmap());
+        list.playback(&canvas);
+    }
+    {
+        my_canvas canvas(expected.bitmap());
+        canvas.save();
+        canvas.scale(3, 3);
+        canvas.drawRect(GRect::MakeLTRB(0, 0, 1, 1), GPaint({ 0, 0, 1, 1 }));
+        canvas.restore();
+        canvas.translate(40, 30);
+        canvas.drawRect(GRect::MakeLTRB(0, 0, 10, 10), GPaint({ 1, 0, 0, 1 }));
+    }
+    int differ = played.diff(expected);
+    MU_CHECK(differ == 0, "%d pixels differ after reset()", differ);
+}
+
+int main() {
+    std::mt19937 rng(1);
+    std::vector<GPixel> pixels(16 * 16);
+    for (GPixel& p : pixels) {
+        unsigned a = rng() % 256;
+        p = GPixel_PackARGB(a, rng() % (a + 1), rng() % (a + 1), rng() % (a + 1));
+    }
+    auto shader = GCreateBitmapShader(GBitmap(16, 16, 16 * sizeof(GPixel), pixels.data(), false),
+                                      GMatrix::Scale(3, 2), GShader::TileMode::kMirror);
+
+    test_playback(shader.get());
+    test_reset();
+    return MUtestResult("display_list_test");
+}
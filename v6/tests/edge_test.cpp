@@ -0,0 +1,71 @@
+/**
+ *  my_edge's fixed-point stepping against the float x it replaces: every row of random edges
+ *  across +-kMaxCoord, and of edges built to land on .5 ties, must round get_X() the way
+ *  GRoundToInt(m * (y + 0.5) + b) does, whether the edge got there by step() or stepTo().
+ */
+
+#include "my_edge.h"
+#include "tests/my_test.h"
+
+#include <random>
+
+// the x of row y before fixed point
+static int float_x(const my_edge& e, int y) {
+    return GRoundToInt(e.m * (y + 0.5) + e.b);
+}
+
+// walk e down its rows, checking each, and jump to a few with stepTo()
+static void check_edge(std::mt19937& rng, GPoint p0, GPoint p1) {
+    my_edge e;
+    if (!e.set(p0, p1, 1)) return;
+
+    my_edge walked = e;
+    for (int y = e.top; y < e.bottom; ++y) {
+        int expected = float_x(e, y);
+        MU_CHECK(walked.get_X() == expected, "edge %.9g,%.9g %.9g,%.9g row %d: step() gives x %d, expected %d",
+                 p0.fX, p0.fY, p1.fX, p1.fY, y, walked.get_X(), expected);
+        walked.step();
+    }
+
+    for (int t = 0; t < 8; ++t) {
+        int y = e.top + rng() % (e.bottom - e.top);
+        my_edge jumped = e;
+        jumped.stepTo(y);
+        walked = e;
+        for (int k = e.top; k < y; ++k) {
+            walked.step();
+        }
+        MU_CHECK(jumped.fx == walked.fx, "edge %.9g,%.9g %.9g,%.9g: stepTo(%d) lands away from step()",
+                 p0.fX, p0.fY, p1.fX, p1.fY, y);
+        MU_CHECK(jumped.get_X() == float_x(e, y), "edge %.9g,%.9g %.9g,%.9g row %d: stepTo() gives x %d, expected %d",
+                 p0.fX, p0.fY, p1.fX, p1.fY, y, jumped.get_X(), float_x(e, y));
+    }
+}
+
+int main() {
+    std::mt19937 rng(1);
+    const int kMax = my_edge::kMaxCoord;
+    auto coord = [&](int range) { return (int) (rng() % (2 * range + 1)) - range + (rng() % 1000) / 1000.f; };
+
+    // anywhere in range, over a few rows or thousands
+    for (int t = 0; t < 3000; ++t) {
+        int rows = t % 3 == 0 ? kMax : 300;
+        GPoint p0 = { std::max(std::min(coord(kMax), (float) kMax), (float) -kMax), (float) (rng() % rows) };
+        GPoint p1 = { std::max(std::min(coord(kMax), (float) kMax), (float) -kMax), (float) (rng() % rows) };
+        p0.fY += (rng() % 1000) / 1000.f;
+        p1.fY += (rng() % 1000) / 1000.f;
+        check_edge(rng, p0, p1);
+    }
+
+    // from a pixel center with a slope of a few 1/2^k, so x sits on a .5 tie every few rows
+    for (int t = 0; t < 3000; ++t) {
+        float x0 = (int) (rng() % (2 * kMax)) - kMax + 0.5f;
+        float y0 = rng() % 2000 + 0.5f;
+        float dx = ((int) (rng() % 65) - 32) / (float) (1 << (rng() % 6));
+        int rows = 1 + rng() % 1000;
+        float x1 = x0 + dx * rows;
+        if (x1 < -kMax || x1 > kMax) continue;
+        check_edge(rng, { x0, y0 }, { x1, y0 + rows });
+    }
+    return MUtestResult("edge_test");
+}
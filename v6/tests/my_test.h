@@ -0,0 +1,62 @@
+#ifndef my_test_DEFINED
+#define my_test_DEFINED
+
+#include "include/GBitmap.h"
+#include "include/GPixel.h"
+
+#include <stdio.h>
+#include <vector>
+
+/**
+ *  The checks in this directory are plain programs, one per area of the rasterizer. Each runs
+ *  its cases, reports the ones that fail and returns non-zero if any did. Those that need
+ *  my_canvas include my_canvas.cpp, so every one builds the same way:
+ *      g++ -std=c++14 -O2 -I<dir holding include/> -Iv6 v6/tests/<name>.cpp
+ *          v6/my_matrix.cpp v6/my_path.cpp -lpthread
+ */
+
+static int gMUtestFailures = 0;
+
+// report a failed check (printf-style message) and carry on, so one run shows every failure
+#define MU_CHECK(cond, ...)                                             \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            gMUtestFailures++;                                          \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);  \
+            fprintf(stderr, __VA_ARGS__);                               \
+            fputc('\n', stderr);                                        \
+        }                                                               \
+    } while (0)
+
+// main()'s result: 0 if every check passed
+static inline int MUtestResult(const char* name) {
+    if (gMUtestFailures == 0) {
+        printf("%s: ok\n", name);
+    } else {
+        printf("%s: %d failed\n", name, gMUtestFailures);
+    }
+    return gMUtestFailures != 0;
+}
+
+// pixels to draw into, with a bitmap over them
+struct my_test_device {
+    my_test_device(int w, int h, GPixel fill = 0) : width(w), height(h), pixels(w * h, fill) {}
+
+    GBitmap bitmap() {
+        return GBitmap(width, height, width * sizeof(GPixel), pixels.data(), false);
+    }
+
+    // how many pixels differ from other's, which is the same size
+    int diff(const my_test_device& other) const {
+        int n = 0;
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            n += pixels[i] != other.pixels[i];
+        }
+        return n;
+    }
+
+    int width, height;
+    std::vector<GPixel> pixels;
+};
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ *  Threaded draws against serial ones. A pool with workers of its own and thresholds of a
+ *  pixel send every drawPaint, drawPath and drawDisplayList down the threaded paths, on any
+ *  machine, and the pixels must come out the same as on one thread, in every AA mode.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <memory>
+#include <random>
+
+static float unit(std::mt19937& rng) {
+    return (rng() % 1001) / 1000.f;
+}
+
+static GPaint paint(std::mt19937& rng, GShader* shader) {
+    const GBlendMode modes[] = { GBlendMode::kSrcOver, GBlendMode::kSrcOver, GBlendMode::kSrc,
+                                 GBlendMode::kDstIn, GBlendMode::kClear, GBlendMode::kXor };
+    float a = rng() % 3 == 0 ? 1 : unit(rng);
+    GPaint p = GPaint({ unit(rng), unit(rng), unit(rng), a }).setBlendMode(modes[rng() % 6]);
+    if (rng() % 4 == 0) {
+        p.setShader(shader);
+    }
+    return p;
+}
+
+static GPoint point(std::mt19937& rng) {
+    return { 560 * unit(rng) - 20, 420 * unit(rng) - 20 };
+}
+
+static void draw_scene(GCanvas* canvas, uint32_t seed, GShader* shader) {
+    std::mt19937 rng(seed);
+    canvas->drawPaint(GPaint({ 1, 1, 1, 1 }));
+    for (int i = 0; i < 30; ++i) {
+        canvas->save();
+        if (rng() % 3 == 0) {
+            canvas->translate(unit(rng) * 20, unit(rng) * 20);
+            canvas->scale(0.5f + unit(rng), 0.5f + unit(rng));
+        }
+        GPath path;
+        switch (rng() % 4) {
+            case 0:
+                canvas->drawPaint(paint(rng, shader));
+                break;
+            case 1:
+                path.addCircle(point(rng), 10 + 200 * unit(rng));
+                canvas->drawPath(path, paint(rng, shader));
+                break;
+            default:
+                path.moveTo(point(rng));
+                for (int k = 0; k < 6; ++k) {
+                    path.lineTo(point(rng));
+                }
+                canvas->drawPath(path, paint(rng, shader));
+                break;
+        }
+        canvas->restore();
+    }
+}
+
+int main() {
+    const my_aa_mode modes[] = { my_aa_mode::kNone, my_aa_mode::kAnalytic,
+                                 my_aa_mode::kSupersample4, my_aa_mode::kSupersample16 };
+    my_thread_pool pool(3);
+
+    std::mt19937 rng(1);
+    std::vector<GPixel> pixels(16 * 16);
+    for (GPixel& p : pixels) {
+        unsigned a = rng() % 256;
+        p = GPixel_PackARGB(a, rng() % (a + 1), rng() % (a + 1), rng() % (a + 1));
+    }
+    auto shader = GCreateBitmapShader(GBitmap(16, 16, 16 * sizeof(GPixel), pixels.data(), false),
+                                      GMatrix::Scale(3, 2), GShader::TileMode::kMirror);
+
+    for (my_aa_mode mode : modes) {
+        for (uint32_t seed = 1; seed <= 8; ++seed) {
+            const int kW = 531, kH = 397;
+            my_test_device serial(kW, kH), threaded(kW, kH), played(kW, kH);
+            {
+                my_canvas canvas(serial.bitmap());
+                canvas.setAntiAlias(mode);
+                draw_scene(&canvas, seed, shader.get());
+            }
+            {
+                my_canvas canvas(threaded.bitmap());
+                canvas.setAntiAlias(mode);
+                canvas.setThreadPool(&pool);
+                canvas.setThreadCount(4);
+                canvas.setParallelThresholds(1, 1);
+                draw_scene(&canvas, seed, shader.get());
+            }
+            int differ = serial.diff(threaded);
+            MU_CHECK(differ == 0, "aa mode %d seed %u: %d pixels differ threaded", (int) mode, seed, differ);
+
+            my_display_list list;
+            my_recording_canvas recorder(&list);
+            draw_scene(&recorder, seed, shader.get());
+            {
+                my_canvas canvas(played.bitmap());
+                canvas.setAntiAlias(mode);
+                canvas.setThreadPool(&pool);
+                canvas.setThreadCount(4);
+                canvas.drawDisplayList(list);
+            }
+            differ = serial.diff(played);
+            MU_CHECK(differ == 0, "aa mode %d seed %u: %d pixels differ in threaded playback", (int) mode, seed, differ);
+        }
+    }
+    return MUtestResult("parallel_test");
+}
@@ -0,0 +1,75 @@
+/**
+ *  my_base_shader::shadeAndBlendRow, as the shader blitter calls it, against shadeRow followed
+ *  by MUblend pixel by pixel, for each of our shaders and every blend mode.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <random>
+
+static const GBlendMode kModes[] = {
+    GBlendMode::kClear, GBlendMode::kSrc, GBlendMode::kDst, GBlendMode::kSrcOver,
+    GBlendMode::kDstOver, GBlendMode::kSrcIn, GBlendMode::kDstIn, GBlendMode::kSrcOut,
+    GBlendMode::kDstOut, GBlendMode::kSrcATop, GBlendMode::kDstATop, GBlendMode::kXor,
+};
+
+static GPixel random_pixel(std::mt19937& rng) {
+    unsigned a = rng() % 256;
+    return GPixel_PackARGB(a, rng() % (a + 1), rng() % (a + 1), rng() % (a + 1));
+}
+
+static void check_shader(std::mt19937& rng, const char* name, my_base_shader* shader) {
+    const int kCount = 93;
+    GPixel dst[kCount], expected[kCount], src[kCount];
+
+    if (!shader->setContext(GMatrix::Translate(3.5f, -2) * GMatrix::Scale(1.5f, 0.75f))) {
+        MU_CHECK(false, "%s: setContext failed", name);
+        return;
+    }
+    for (GBlendMode mode : kModes) {
+        for (int t = 0; t < 20; ++t) {
+            int x = rng() % 200 - 50, y = rng() % 200 - 50;
+            shader->shadeRow(x, y, kCount, src);
+            for (int i = 0; i < kCount; ++i) {
+                dst[i] = random_pixel(rng);
+                expected[i] = MUblend(src[i], dst[i], mode);
+            }
+            shader->shadeAndBlendRow(x, y, kCount, dst, mode, MUchooseSimdBlendProcs(mode).row);
+            int differ = 0;
+            for (int i = 0; i < kCount; ++i) {
+                differ += dst[i] != expected[i];
+            }
+            MU_CHECK(differ == 0, "%s mode %d row (%d, %d): %d pixels differ", name, (int) mode, x, y, differ);
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rng(1);
+    my_scratch scratch(256);
+    my_scratch::binding bind(scratch);
+
+    my_test_device texture(16, 16);
+    for (GPixel& p : texture.pixels) {
+        p = random_pixel(rng);
+    }
+    GColor colors[3] = { { 1, 0, 0, 0.5f }, { 0, 1, 0.5f, 1 }, { 0.2f, 0.3f, 1, 0.8f } };
+    GPoint points[3] = { { 10, 5 }, { 150, 40 }, { 60, 170 } };
+
+    for (GShader::TileMode tm : { GShader::TileMode::kClamp, GShader::TileMode::kRepeat, GShader::TileMode::kMirror }) {
+        my_shader bitmap(texture.bitmap(), GMatrix::Scale(3, 2), tm);
+        check_shader(rng, "bitmap", &bitmap);
+        my_linear_gradient gradient({ 5, 10 }, { 120, 60 }, colors, 3, tm);
+        check_shader(rng, "gradient", &gradient);
+    }
+    my_shader bitmap(texture.bitmap(), GMatrix(), GShader::TileMode::kRepeat);
+    my_tri_color_shader tri(points, colors);
+    check_shader(rng, "tri-color", &tri);
+    my_proxy_shader proxy(&bitmap, GMatrix::Rotate(0.3f));
+    check_shader(rng, "proxy", &proxy);
+    my_composite_shader composite(&tri, &bitmap);
+    check_shader(rng, "composite", &composite);
+
+    return MUtestResult("shader_blend_test");
+}
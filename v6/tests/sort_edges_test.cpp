@@ -0,0 +1,68 @@
+/**
+ *  MUbucketSortEdges and MUsortEdges against MUinsertionSort(MULT): the same edges in the same
+ *  MULT order, for tops over a few rows or thousands, with many ties in top, x and slope.
+ */
+
+#include "my_utils.h"
+#include "tests/my_test.h"
+
+#include <random>
+#include <tuple>
+
+// the same edges in the same order, but for the order of edges MULT can't tell apart
+static bool same_order(const std::vector<my_edge>& got, const std::vector<my_edge>& expected) {
+    if (got.size() != expected.size()) return false;
+    auto key = [](const my_edge& e) { return std::make_tuple(e.top, e.fx, e.m, e.bottom, e.winding, e.fdx); };
+    for (size_t i = 0; i < got.size(); ++i) {
+        if (MULT(got[i], expected[i]) || MULT(expected[i], got[i])) return false;
+    }
+    std::vector<my_edge> a = got, b = expected;
+    auto less = [&](const my_edge& x, const my_edge& y) { return key(x) < key(y); };
+    std::sort(a.begin(), a.end(), less);
+    std::sort(b.begin(), b.end(), less);
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (key(a[i]) != key(b[i])) return false;
+    }
+    return true;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    my_edge_sort_scratch scratch;     // shared, as the canvas shares it, so it's reused dirty
+
+    for (int t = 0; t < 3000; ++t) {
+        int count = rng() % 4 == 0 ? rng() % 8 : 1 + rng() % 600;
+        int rows = 1 + rng() % (rng() % 2 ? 16 : 8192);
+        int xs = 1 + rng() % (rng() % 2 ? 8 : 100000);
+        int top0 = (int) (rng() % 200) - 100;
+
+        std::vector<my_edge> edges(count);
+        for (my_edge& e : edges) {
+            e.top = top0 + rng() % rows;
+            e.bottom = e.top + 1 + rng() % 64;
+            e.fx = ((int64_t) (rng() % xs) - xs / 2) << 30;
+            e.m = (int) (rng() % 5) - 2;
+            e.fdx = my_edge::toFixed(e.m);
+            e.winding = rng() % 2 ? 1 : -1;
+        }
+
+        std::vector<my_edge> expected = edges;
+        MUinsertionSort(expected, MULT);
+
+        if (count > 0) {
+            int min_top = edges[0].top, max_top = edges[0].top;
+            for (const my_edge& e : edges) {
+                min_top = std::min(min_top, e.top);
+                max_top = std::max(max_top, e.top);
+            }
+            std::vector<my_edge> bucketed = edges;
+            MUbucketSortEdges(bucketed, min_top, max_top, scratch);
+            MU_CHECK(same_order(bucketed, expected), "%d edges over %d rows: MUbucketSortEdges order differs", count, rows);
+        }
+
+        std::vector<my_edge> sorted = edges;
+        MUsortEdges(sorted, scratch);
+        MU_CHECK(same_order(sorted, expected), "%d edges over %d rows: MUsortEdges order differs", count, rows);
+    }
+    return MUtestResult("sort_edges_test");
+}
@@ -0,0 +1,123 @@
+/**
+ *  Tiled draws against immediate ones: a scene of rects, polygons and paths, solid and
+ *  shaded, some reaching far off the device, must come out the same either way in every AA
+ *  mode.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <memory>
+#include <random>
+
+static float unit(std::mt19937& rng) {
+    return (rng() % 1001) / 1000.f;
+}
+
+static GColor color(std::mt19937& rng) {
+    float a = rng() % 3 == 0 ? 1 : unit(rng);
+    return { unit(rng), unit(rng), unit(rng), a };
+}
+
+static GPaint paint(std::mt19937& rng, const std::vector<std::unique_ptr<GShader>>& shaders) {
+    const GBlendMode modes[] = { GBlendMode::kSrcOver, GBlendMode::kSrcOver, GBlendMode::kSrc,
+                                 GBlendMode::kDstIn, GBlendMode::kClear, GBlendMode::kXor };
+    GPaint p = GPaint(color(rng)).setBlendMode(modes[rng() % 6]);
+    if (rng() % 4 == 0) {
+        p.setShader(shaders[rng() % shaders.size()].get());
+    }
+    return p;
+}
+
+static GPoint point(std::mt19937& rng) {
+    return { 240 * unit(rng) - 20, 190 * unit(rng) - 20 };
+}
+
+static void draw_scene(GCanvas* canvas, uint32_t seed, const std::vector<std::unique_ptr<GShader>>& shaders) {
+    std::mt19937 rng(seed);
+    auto coord = [&](float size) {
+        switch (rng() % 8) {
+            case 0: return -2e9f * (1 + unit(rng));
+            case 1: return 2e9f * (1 + unit(rng));
+            default: return (size + 40) * unit(rng) - 20;
+        }
+    };
+
+    canvas->drawPaint(GPaint({ 1, 1, 1, 1 }));
+    for (int i = 0; i < 40; ++i) {
+        canvas->save();
+        if (rng() % 3 == 0) {
+            canvas->translate(unit(rng) * 20, unit(rng) * 20);
+            canvas->scale(0.5f + unit(rng), 0.5f + unit(rng));
+        }
+        switch (rng() % 5) {
+            case 0:
+            case 1: {
+                float x0 = coord(200), x1 = coord(200), y0 = coord(150), y1 = coord(150);
+                canvas->drawRect(GRect::MakeLTRB(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1)),
+                                 paint(rng, shaders));
+                break;
+            }
+            case 2: {
+                GPoint pts[3] = { point(rng), point(rng), point(rng) };
+                canvas->drawConvexPolygon(pts, 3, paint(rng, shaders));
+                break;
+            }
+            case 3: {
+                GPath path;
+                path.moveTo(point(rng));
+                for (int k = 0; k < 5; ++k) {
+                    path.lineTo(point(rng));
+                }
+                canvas->drawPath(path, paint(rng, shaders));
+                break;
+            }
+            case 4: {
+                GPath path;
+                GPoint c = point(rng);
+                path.addCircle(c, 5 + 60 * unit(rng));
+                canvas->drawPath(path, paint(rng, shaders));
+                break;
+            }
+        }
+        canvas->restore();
+    }
+}
+
+int main() {
+    const my_aa_mode modes[] = { my_aa_mode::kNone, my_aa_mode::kAnalytic,
+                                 my_aa_mode::kSupersample4, my_aa_mode::kSupersample16 };
+
+    // the shaders must outlive the tiled canvases, which only shade at flush()
+    std::mt19937 rng(1);
+    std::vector<GPixel> pixels(16 * 16);
+    for (GPixel& p : pixels) {
+        unsigned a = rng() % 256;
+        p = GPixel_PackARGB(a, rng() % (a + 1), rng() % (a + 1), rng() % (a + 1));
+    }
+    GColor stops[3] = { color(rng), color(rng), color(rng) };
+    std::vector<std::unique_ptr<GShader>> shaders;
+    shaders.emplace_back(GCreateBitmapShader(GBitmap(16, 16, 16 * sizeof(GPixel), pixels.data(), false),
+                                             GMatrix::Scale(3, 2), GShader::TileMode::kRepeat));
+    shaders.emplace_back(GCreateLinearGradient({ 10, 20 }, { 180, 130 }, stops, 3, GShader::TileMode::kMirror));
+
+    for (my_aa_mode mode : modes) {
+        for (uint32_t seed = 1; seed <= 25; ++seed) {
+            my_test_device immediate(203, 151), tiled(203, 151);
+            {
+                my_canvas canvas(immediate.bitmap());
+                canvas.setAntiAlias(mode);
+                draw_scene(&canvas, seed, shaders);
+            }
+            {
+                my_canvas canvas(tiled.bitmap());
+                canvas.setAntiAlias(mode);
+                canvas.setTiled(true);
+                draw_scene(&canvas, seed, shaders);
+            }
+            int differ = immediate.diff(tiled);
+            MU_CHECK(differ == 0, "aa mode %d seed %u: %d pixels differ tiled", (int) mode, seed, differ);
+        }
+    }
+    return MUtestResult("tiled_test");
+}
@@ -0,0 +1,85 @@
+/**
+ *  my_tri_color_shader gives a pixel the same color whatever span it is shaded in, so colored
+ *  meshes come out the same tiled as immediate.
+ */
+
+#include "my_canvas.cpp"
+#include "tests/my_test.h"
+
+#include <random>
+
+static float unit(std::mt19937& rng) {
+    return (rng() % 1001) / 1000.f;
+}
+
+static GColor color(std::mt19937& rng) {
+    return { unit(rng), unit(rng), unit(rng), 0.2f + 0.8f * unit(rng) };
+}
+
+static void test_split_spans(std::mt19937& rng) {
+    const int kWidth = 300;
+    GPixel whole[kWidth], split[kWidth];
+
+    for (int t = 0; t < 200; ++t) {
+        GPoint pts[3] = { { 300 * unit(rng), 300 * unit(rng) }, { 300 * unit(rng), 300 * unit(rng) },
+                          { 300 * unit(rng), 300 * unit(rng) } };
+        GColor colors[3] = { color(rng), color(rng), color(rng) };
+        my_tri_color_shader shader(pts, colors);
+        if (!shader.setContext(GMatrix())) continue;
+
+        int y = rng() % 300;
+        shader.shadeRow(0, y, kWidth, whole);
+        for (int x = 0; x < kWidth;) {
+            int count = std::min(kWidth - x, 1 + (int) (rng() % 70));
+            shader.shadeRow(x, y, count, split + x);
+            x += count;
+        }
+        int differ = 0;
+        for (int x = 0; x < kWidth; ++x) {
+            differ += whole[x] != split[x];
+        }
+        MU_CHECK(differ == 0, "triangle %d row %d: %d pixels depend on their span", t, y, differ);
+    }
+}
+
+static void draw_quads(GCanvas* canvas, uint32_t seed) {
+    std::mt19937 rng(seed);
+    for (int i = 0; i < 12; ++i) {
+        GPoint verts[4];
+        for (GPoint& p : verts) {
+            p = { 320 * unit(rng) - 10, 250 * unit(rng) - 10 };
+        }
+        GColor colors[4] = { color(rng), color(rng), color(rng), color(rng) };
+        canvas->drawQuad(verts, colors, nullptr, rng() % 4, GPaint());
+    }
+}
+
+static void test_tiled_meshes() {
+    const my_aa_mode modes[] = { my_aa_mode::kNone, my_aa_mode::kAnalytic,
+                                 my_aa_mode::kSupersample4, my_aa_mode::kSupersample16 };
+    for (my_aa_mode mode : modes) {
+        for (uint32_t seed = 1; seed <= 10; ++seed) {
+            my_test_device immediate(301, 237), tiled(301, 237);
+            {
+                my_canvas canvas(immediate.bitmap());
+                canvas.setAntiAlias(mode);
+                draw_quads(&canvas, seed);
+            }
+            {
+                my_canvas canvas(tiled.bitmap());
+                canvas.setAntiAlias(mode);
+                canvas.setTiled(true);
+                draw_quads(&canvas, seed);
+            }
+            int differ = immediate.diff(tiled);
+            MU_CHECK(differ == 0, "aa mode %d seed %u: %d pixels differ tiled", (int) mode, seed, differ);
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rng(1);
+    test_split_spans(rng);
+    test_tiled_meshes();
+    return MUtestResult("tri_color_shader_test");
+}